@@ -0,0 +1,270 @@
+// chya_bench: generates a synthetic project and times chya's hot paths, printing JSON results.
+#include "composite.h"
+#include "media_import.h"
+#include "project_db.h"
+#include "render.h"
+#include "stb_image.h"
+#include "synthetic_project.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <filesystem>
+#include <functional>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+struct BenchResult {
+  std::string name;
+  int iterations = 0;     // timed repetitions
+  double items = 0.;      // work items per repetition (frames, lookups, files, ...)
+  double min_ms = 0.;
+  double mean_ms = 0.;
+  std::string error;      // set if the benchmark could not run
+  std::vector<std::pair<std::string, double>> extra;
+};
+
+// Runs fn `iterations` times and records min/mean wall time. fn returns false to abort.
+BenchResult time_it(const std::string& name, int iterations, double items, const std::function<bool()>& fn) {
+  BenchResult r;
+  r.name = name;
+  r.items = items;
+  double total = 0.;
+  for (int i = 0; i < iterations; i++) {
+    const auto t0 = Clock::now();
+    if (!fn()) {
+      r.error = "failed";
+      return r;
+    }
+    const double ms = std::chrono::duration<double, std::milli>(Clock::now() - t0).count();
+    r.min_ms = (i == 0) ? ms : std::min(r.min_ms, ms);
+    total += ms;
+    r.iterations++;
+  }
+  r.mean_ms = r.iterations > 0 ? total / r.iterations : 0.;
+  return r;
+}
+
+std::string json_escape(const std::string& s) {
+  std::string out;
+  for (char c : s) {
+    if (c == '"' || c == '\\') out += '\\';
+    if (static_cast<unsigned char>(c) < 0x20) continue;
+    out += c;
+  }
+  return out;
+}
+
+void print_json(std::FILE* out, const SyntheticProjectSpec& spec, const std::vector<BenchResult>& results) {
+  std::fprintf(out, "{\n  \"version\": \"%s\",\n", CHYA_VERSION);
+  std::fprintf(out, "  \"config\": {\"scenes\": %d, \"layers_per_scene\": %d, \"media\": %d, \"image_width\": %d, "
+               "\"image_height\": %d, \"output_width\": %d, \"output_height\": %d, \"max_hold\": %d},\n",
+               spec.scenes, spec.layers_per_scene, spec.media_count, spec.image_width, spec.image_height,
+               spec.output_width, spec.output_height, spec.max_hold);
+  std::fprintf(out, "  \"results\": [\n");
+  for (size_t i = 0; i < results.size(); i++) {
+    const BenchResult& r = results[i];
+    std::fprintf(out, "    {\"name\": \"%s\", \"iterations\": %d, \"items\": %.0f, \"min_ms\": %.4f, \"mean_ms\": %.4f",
+                 r.name.c_str(), r.iterations, r.items, r.min_ms, r.mean_ms);
+    if (r.min_ms > 0. && r.items > 0.)
+      std::fprintf(out, ", \"items_per_sec\": %.2f", r.items / (r.min_ms / 1000.));
+    for (const auto& [k, v] : r.extra)
+      std::fprintf(out, ", \"%s\": %.4f", k.c_str(), v);
+    if (!r.error.empty())
+      std::fprintf(out, ", \"error\": \"%s\"", json_escape(r.error).c_str());
+    std::fprintf(out, "}%s\n", i + 1 < results.size() ? "," : "");
+  }
+  std::fprintf(out, "  ]\n}\n");
+}
+
+void print_usage() {
+  std::fprintf(stderr,
+      "Usage: chya_bench [options]\n"
+      "  --scenes N          scenes in the synthetic project (default 4)\n"
+      "  --layers N          layers per scene (default 250)\n"
+      "  --media N           media images (default 24)\n"
+      "  --image WxH         media image size (default 3000x2000)\n"
+      "  --output-size WxH   export size (default 1920x1080)\n"
+      "  --iterations N      repetitions of the fast benchmarks (default 5)\n"
+      "  --dir PATH          where to generate the project (default: temp dir, removed afterwards)\n"
+      "  --json PATH         write results to PATH instead of stdout\n"
+      "  --skip-export       do not run the export benchmark (needs ffmpeg)\n");
+}
+
+bool parse_size(const char* s, int* w, int* h) {
+  return std::sscanf(s, "%dx%d", w, h) == 2 && *w > 0 && *h > 0;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  SyntheticProjectSpec spec;
+  int iterations = 5;
+  std::string dir, json_path;
+  bool skip_export = false;
+  for (int i = 1; i < argc; i++) {
+    const std::string a = argv[i];
+    const char* v = (i + 1 < argc) ? argv[i + 1] : nullptr;
+    bool ok = true;
+    if (a == "--scenes" && v) spec.scenes = std::atoi(argv[++i]);
+    else if (a == "--layers" && v) spec.layers_per_scene = std::atoi(argv[++i]);
+    else if (a == "--media" && v) spec.media_count = std::atoi(argv[++i]);
+    else if (a == "--image" && v) ok = parse_size(argv[++i], &spec.image_width, &spec.image_height);
+    else if (a == "--output-size" && v) ok = parse_size(argv[++i], &spec.output_width, &spec.output_height);
+    else if (a == "--iterations" && v) iterations = std::max(1, std::atoi(argv[++i]));
+    else if (a == "--dir" && v) dir = argv[++i];
+    else if (a == "--json" && v) json_path = argv[++i];
+    else if (a == "--skip-export") skip_export = true;
+    else if (a == "--help") {
+      print_usage();
+      return 0;
+    } else ok = false;
+    if (!ok) {
+      print_usage();
+      return 2;
+    }
+  }
+
+  const bool temp_dir = dir.empty();
+  if (temp_dir)
+    dir = (fs::temp_directory_path() / ("chya_bench_" + std::to_string(std::time(nullptr)))).string();
+  std::error_code ec;
+  if (fs::exists(fs::path(dir) / "project.db", ec)) {
+    std::fprintf(stderr, "chya_bench: %s already contains a project\n", dir.c_str());
+    return 2;
+  }
+  std::fprintf(stderr, "Generating synthetic project in %s...\n", dir.c_str());
+  std::string error;
+  if (!generate_synthetic_project(dir, spec, &error)) {
+    std::fprintf(stderr, "chya_bench: %s\n", error.c_str());
+    return 1;
+  }
+  const std::string db_path = (fs::path(dir) / "project.db").string();
+  std::vector<BenchResult> results;
+
+  results.push_back(time_it("schema_open", iterations, 1, [&]() {
+    sqlite3* raw = nullptr;
+    bool ok = sqlite3_open(db_path.c_str(), &raw) == SQLITE_OK && init_schema(raw);
+    sqlite3_close(raw);
+    return ok;
+  }));
+
+  sqlite3* raw = nullptr;
+  sqlite3_open(db_path.c_str(), &raw);
+  SqliteDb db(raw);
+  const std::vector<SceneRow> scenes = list_scenes(db.get());
+  const double total_layers = static_cast<double>(scenes.size()) * spec.layers_per_scene;
+
+  results.push_back(time_it("list_layers", iterations, total_layers, [&]() {
+    size_t n = 0;
+    for (const SceneRow& s : scenes) n += list_layers(db.get(), s.id).size();
+    return n > 0 || total_layers == 0.;
+  }));
+
+  std::vector<SceneFrameIndex> indices;
+  results.push_back(time_it("frame_index_build", iterations, static_cast<double>(scenes.size()), [&]() {
+    indices.clear();
+    for (const SceneRow& s : scenes) indices.push_back(build_scene_frame_index(db.get(), s.id));
+    return true;
+  }));
+
+  double total_frames = 0.;
+  for (const SceneFrameIndex& idx : indices) total_frames += idx.frame_count();
+  volatile size_t sink = 0;
+  results.push_back(time_it("frame_lookup", iterations, total_frames, [&]() {
+    for (const SceneFrameIndex& idx : indices)
+      for (int f = 0; f < idx.frame_count(); f++)
+        if (const LayerRow* l = idx.layer_at(f)) sink = sink + l->media_id;
+    return true;
+  }));
+
+  // Clips in a 240-frame timeline window, slid across every scene in steps of one window.
+  std::vector<int> visible;
+  results.push_back(time_it("visible_layers", iterations, total_frames / 240., [&]() {
+    for (const SceneFrameIndex& idx : indices)
+      for (int f = 0; f < idx.frame_count(); f += 240) {
+        idx.layers_in_range(f, f + 240, &visible);
+        sink = sink + visible.size();
+      }
+    return true;
+  }));
+
+  // Write latency of single layer edits: one autocommitted update per layer of the first scene. A timeline
+  // drag writes once when the drag ends, not per frame.
+  const std::vector<LayerRow> edit_layers = indices.empty() ? std::vector<LayerRow>() : indices.front().layers;
+  results.push_back(time_it("layer_edit", iterations, static_cast<double>(edit_layers.size()), [&]() {
+    for (const LayerRow& l : edit_layers)
+      if (!update_layer_start_frame(db.get(), l.id, l.start_frame)) return false;
+    return true;
+  }));
+
+  const std::vector<MediaRow> media = list_media(db.get());
+  results.push_back(time_it("thumbnail_decode", 1, static_cast<double>(media.size()), [&]() {
+    for (const MediaRow& m : media) {
+      int w = 0, h = 0, c = 0;
+      unsigned char* px = stbi_load((fs::path(dir) / m.path).string().c_str(), &w, &h, &c, 4);
+      if (!px) return false;
+      stbi_image_free(px);
+    }
+    return true;
+  }));
+
+  // Premultiplied blend of one output-sized layer over another, as export does per extra layer.
+  const size_t blend_pixels = static_cast<size_t>(spec.output_width) * spec.output_height;
+  std::vector<unsigned char> blend_top(blend_pixels * 4), blend_acc(blend_pixels * 4, 255);
+  for (size_t i = 0; i < blend_top.size(); i++) blend_top[i] = static_cast<unsigned char>(i * 7);
+  premultiply_rgba(blend_top.data(), blend_pixels);
+  results.push_back(time_it("blend_over", iterations, 1, [&]() {
+    blend_over(blend_top.data(), blend_acc.data(), blend_acc.data(), blend_pixels);
+    return true;
+  }));
+
+  std::vector<std::string> import_files;
+  for (const auto& e : fs::directory_iterator(fs::path(dir) / "import_src", ec))
+    if (e.is_regular_file()) import_files.push_back(e.path().string());
+  results.push_back(time_it("media_import", 1, static_cast<double>(import_files.size()), [&]() {
+    MediaImporter importer;
+    if (!importer.add(dir, import_files)) return false;
+    std::vector<ImportedMedia> imported;
+    int failed = 0;
+    while (!importer.take_finished(&imported, &failed))
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    std::vector<MediaRow> rows;
+    for (ImportedMedia& m : imported) rows.push_back(std::move(m.media));
+    return failed == 0 && add_media_rows(db.get(), rows) >= 0;
+  }));
+
+  if (!skip_export) {
+    const std::string out = (fs::path(dir) / "bench_export.mp4").string();
+    RenderStats stats;
+    std::string render_error;
+    BenchResult r = time_it("export", 1, total_frames, [&]() {
+      return render_project_to_video(db.get(), dir, out, nullptr, &render_error, &stats);
+    });
+    if (!r.error.empty()) r.error = render_error;
+    r.extra = {{"rendered_runs", static_cast<double>(stats.rendered_runs)}, {"setup_sec", stats.setup_sec},
+               {"decode_sec", stats.decode_sec}, {"scale_sec", stats.scale_sec}, {"encode_sec", stats.encode_sec},
+               {"cached_frames", static_cast<double>(stats.cached_frames)}};
+    results.push_back(r);
+  }
+
+  db.reset();
+  if (temp_dir) fs::remove_all(dir, ec);
+
+  std::FILE* out = stdout;
+  if (!json_path.empty() && !(out = std::fopen(json_path.c_str(), "w"))) {
+    std::fprintf(stderr, "chya_bench: cannot write %s\n", json_path.c_str());
+    return 1;
+  }
+  print_json(out, spec, results);
+  if (out != stdout) std::fclose(out);
+  return 0;
+}
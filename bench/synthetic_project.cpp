@@ -0,0 +1,90 @@
+#include "synthetic_project.h"
+#include "stb_image_write.h"
+#include "project_db.h"
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+#include <random>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+// Smooth gradients plus a per-image offset: compresses like a photo rather than like noise.
+void fill_test_image(std::vector<unsigned char>& px, int w, int h, int variant) {
+  px.resize(static_cast<size_t>(w) * h * 3);
+  for (int y = 0; y < h; y++) {
+    for (int x = 0; x < w; x++) {
+      unsigned char* p = &px[(static_cast<size_t>(y) * w + x) * 3];
+      p[0] = static_cast<unsigned char>((x * 255 / std::max(1, w - 1) + variant * 37) & 255);
+      p[1] = static_cast<unsigned char>((y * 255 / std::max(1, h - 1) + variant * 11) & 255);
+      p[2] = static_cast<unsigned char>(((x ^ y) >> 3) + variant);
+    }
+  }
+}
+
+}  // namespace
+
+bool generate_synthetic_project(const std::string& dir, const SyntheticProjectSpec& spec, std::string* error) {
+  auto fail = [&](const std::string& msg) {
+    if (error) *error = msg;
+    return false;
+  };
+  std::error_code ec;
+  const fs::path root(dir);
+  fs::create_directories(root / "media", ec);
+  fs::create_directories(root / "import_src", ec);
+  if (ec) return fail("cannot create " + dir + ": " + ec.message());
+
+  std::vector<std::string> media;
+  std::vector<unsigned char> px;
+  for (int i = 0; i < spec.media_count; i++) {
+    char name[64];
+    snprintf(name, sizeof(name), "synth_%04d.jpg", i);
+    fill_test_image(px, spec.image_width, spec.image_height, i);
+    const std::string path = (root / "import_src" / name).string();
+    if (!stbi_write_jpg(path.c_str(), spec.image_width, spec.image_height, 3, px.data(), 90))
+      return fail("cannot write " + path);
+    fs::copy_file(path, root / "media" / name, fs::copy_options::overwrite_existing, ec);
+    if (ec) return fail("cannot copy " + path + ": " + ec.message());
+    media.push_back(std::string("media/") + name);
+  }
+
+  sqlite3* raw = nullptr;
+  if (sqlite3_open((root / "project.db").string().c_str(), &raw) != SQLITE_OK || !init_schema(raw)) {
+    sqlite3_close(raw);
+    return fail("cannot create project.db");
+  }
+  SqliteDb db(raw);
+  std::mt19937 rng(spec.seed);
+  std::uniform_int_distribution<int> pick_media(0, std::max(0, spec.media_count - 1));
+  std::uniform_int_distribution<int> pick_hold(1, std::max(1, spec.max_hold));
+  int longest_scene = 0;
+  run_sql(db.get(), "BEGIN");
+  std::vector<int> media_ids;
+  for (const std::string& m : media) {
+    char* sql = sqlite3_mprintf("INSERT INTO media(path) VALUES('%q')", m.c_str());
+    run_sql(db.get(), sql);
+    sqlite3_free(sql);
+    media_ids.push_back(static_cast<int>(sqlite3_last_insert_rowid(db.get())));
+  }
+  for (int s = 0; s < spec.scenes; s++) {
+    create_scene(db.get());
+    const int scene_id = static_cast<int>(sqlite3_last_insert_rowid(db.get()));
+    int frame = 0;
+    for (int l = 0; l < spec.layers_per_scene && !media.empty(); l++) {
+      const int hold = pick_hold(rng);
+      add_layer_at_frame(db.get(), scene_id, frame, media_ids[pick_media(rng)], hold);
+      frame += hold;
+    }
+    longest_scene = std::max(longest_scene, frame);
+  }
+  MovieConfig cfg;
+  cfg.width = spec.output_width;
+  cfg.height = spec.output_height;
+  cfg.duration_sec = std::max(1., longest_scene / cfg.frame_rate);
+  set_movie_config(db.get(), cfg);
+  if (!run_sql(db.get(), "COMMIT")) return fail("cannot write project.db");
+  return true;
+}
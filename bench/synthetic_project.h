@@ -0,0 +1,21 @@
+#pragma once
+#include <cstdint>
+#include <string>
+
+// Shape of a generated benchmark project.
+struct SyntheticProjectSpec {
+  int scenes = 4;
+  int layers_per_scene = 250;
+  int media_count = 24;
+  int image_width = 3000;
+  int image_height = 2000;
+  int output_width = 1920;  // movie_config export size
+  int output_height = 1080;
+  int max_hold = 3;  // layers hold 1..max_hold frames ("on ones" to "on threes")
+  uint32_t seed = 1;
+};
+
+// Writes media images to <dir>/media and a project.db with spec.scenes scenes of back-to-back layers that
+// reference random media. Also writes the same images to <dir>/import_src for import benchmarks.
+// dir must not exist yet or be empty. Returns false with *error set on failure.
+bool generate_synthetic_project(const std::string& dir, const SyntheticProjectSpec& spec, std::string* error);
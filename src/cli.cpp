@@ -0,0 +1,150 @@
+#include "cli.h"
+#include "project_db.h"
+#include "render.h"
+#include "self_check.h"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <string>
+#include <thread>
+#include <unistd.h>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+constexpr int kExitOk = 0;
+constexpr int kExitRenderFailed = 1;
+constexpr int kExitCheckFailed = 1;
+constexpr int kExitUsage = 2;
+constexpr int kExitBadProject = 3;
+
+void print_usage(std::FILE* out) {
+  std::fprintf(out,
+      "Usage:\n"
+      "  chya                              start the editor\n"
+      "  chya --render [--gpu] <project> <output>\n"
+      "                                    render all scenes of <project> (a project folder or its\n"
+      "                                    project.db) to the video file <output> using ffmpeg;\n"
+      "                                    --gpu scales frames with OpenGL when a context is available\n"
+      "  chya --self-check                 compare the optimized image paths with their references,\n"
+      "                                    and the OpenGL scaler with the CPU when a context is available\n"
+      "  chya --help                       show this message\n");
+}
+
+int render_command(const std::string& project_arg, const std::string& output_path, GpuScalerFactory make_gpu_scaler) {
+  fs::path project_root(project_arg);
+  if (project_root.filename() == "project.db")
+    project_root = project_root.parent_path();
+  const fs::path db_path = project_root / "project.db";
+  std::error_code ec;
+  if (!fs::is_regular_file(db_path, ec)) {
+    std::fprintf(stderr, "chya: %s is not a chya project (no project.db)\n", project_root.string().c_str());
+    return kExitBadProject;
+  }
+  sqlite3* raw = nullptr;
+  if (sqlite3_open_v2(db_path.string().c_str(), &raw, SQLITE_OPEN_READWRITE, nullptr) != SQLITE_OK || !init_schema(raw)) {
+    std::fprintf(stderr, "chya: cannot open %s: %s\n", db_path.string().c_str(), raw ? sqlite3_errmsg(raw) : "out of memory");
+    sqlite3_close(raw);
+    return kExitBadProject;
+  }
+  SqliteDb db(raw);
+  // Created on this thread: it may own a window, which only the main thread can create or destroy.
+  std::unique_ptr<FrameScaler> scaler = make_gpu_scaler ? make_gpu_scaler() : nullptr;
+  if (make_gpu_scaler && !scaler)
+    std::fprintf(stderr, "chya: no OpenGL context available, scaling on the CPU\n");
+
+  std::printf("Rendering %s -> %s\n", project_root.string().c_str(), output_path.c_str());
+  std::fflush(stdout);
+  std::atomic<float> progress(0.f);
+  std::atomic<bool> finished(false);
+  std::string error;
+  RenderStats stats;
+  bool ok = false;
+  std::thread worker([&]() {
+    ok = render_project_to_video(db.get(), project_root.string(), output_path, &progress, &error, &stats, scaler.get());
+    finished.store(true);
+  });
+  // On a terminal redraw one line; in logs print a line per 10%.
+  const bool tty = isatty(fileno(stdout)) != 0;
+  int last_pct = -1;
+  while (!finished.load()) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    int pct = static_cast<int>(progress.load() * 100.f);
+    if (tty && pct != last_pct) {
+      std::printf("\r  %3d%%", pct);
+      std::fflush(stdout);
+      last_pct = pct;
+    } else if (!tty && (last_pct < 0 || pct / 10 != last_pct / 10)) {
+      std::printf("  %3d%%\n", pct);
+      std::fflush(stdout);
+      last_pct = pct;
+    }
+  }
+  worker.join();
+  if (tty) std::printf("\n");
+
+  if (!ok) {
+    std::fprintf(stderr, "chya: render failed: %s\n", error.empty() ? "unknown error" : error.c_str());
+    return kExitRenderFailed;
+  }
+  std::printf("Rendered %d frames (%d runs composited) in %.2f s, %.1f fps\n", stats.frames, stats.rendered_runs,
+              stats.total_sec, stats.total_sec > 0. ? stats.frames / stats.total_sec : 0.);
+  std::printf("  setup   %8.3f s\n", stats.setup_sec);
+  std::printf("  decode  %8.3f s (all threads)\n", stats.decode_sec);
+  std::printf("  scale   %8.3f s (%s)\n", stats.scale_sec, stats.gpu_scaled ? "gpu" : "all threads");
+  std::printf("  encode  %8.3f s\n", stats.encode_sec);
+  if (stats.chunks > 1 || stats.cached_chunks > 0)
+    std::printf("  cache   %d of %d chunks reused (%d frames)\n", stats.cached_chunks, stats.chunks, stats.cached_frames);
+  if (stats.repeated_chunks > 0)
+    std::printf("  repeat  %d chunks joined again within the video (%d frames)\n", stats.repeated_chunks,
+                stats.repeated_frames);
+  return kExitOk;
+}
+
+int self_check_command(GpuScalerFactory make_gpu_scaler) {
+  bool ok = check_resample_against_reference(stdout);
+  ok = check_composite_against_reference(stdout) && ok;
+  // Created on this thread, like the render's scaler.
+  std::unique_ptr<FrameScaler> scaler = make_gpu_scaler ? make_gpu_scaler() : nullptr;
+  if (scaler)
+    ok = check_scaler_against_cpu(scaler.get(), stdout) && ok;
+  else
+    std::printf("skip gpu: no OpenGL context available\n");
+  std::printf("%s\n", ok ? "All checks passed" : "Some checks failed");
+  return ok ? kExitOk : kExitCheckFailed;
+}
+
+}  // namespace
+
+bool is_cli_invocation(int argc, char** argv) {
+  return argc > 1 && argv[1] && std::strncmp(argv[1], "--", 2) == 0;
+}
+
+int run_cli(int argc, char** argv, GpuScalerFactory make_gpu_scaler) {
+  const std::string cmd = argc > 1 ? argv[1] : "";
+  if (cmd == "--help") {
+    print_usage(stdout);
+    return kExitOk;
+  }
+  if (cmd == "--render") {
+    const bool gpu = argc > 2 && std::strcmp(argv[2], "--gpu") == 0;
+    if (argc != (gpu ? 5 : 4)) {
+      print_usage(stderr);
+      return kExitUsage;
+    }
+    return render_command(argv[gpu ? 3 : 2], argv[gpu ? 4 : 3], gpu ? make_gpu_scaler : nullptr);
+  }
+  if (cmd == "--self-check") {
+    if (argc != 2) {
+      print_usage(stderr);
+      return kExitUsage;
+    }
+    return self_check_command(make_gpu_scaler);
+  }
+  std::fprintf(stderr, "chya: unknown option %s\n", cmd.c_str());
+  print_usage(stderr);
+  return kExitUsage;
+}
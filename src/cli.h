@@ -0,0 +1,14 @@
+#pragma once
+#include <memory>
+
+class FrameScaler;
+using GpuScalerFactory = std::unique_ptr<FrameScaler> (*)();
+
+// True if the arguments select a command-line mode (first argument starts with "--") instead of the GUI.
+bool is_cli_invocation(int argc, char** argv);
+
+// Runs the command-line mode. No window or GL context is created unless --render --gpu or --self-check asks
+// for one through make_gpu_scaler; without it (or when it returns nullptr) frames are scaled on the CPU. Returns the process
+// exit status: 0 on success, 1 if the render or a self-check failed, 2 on bad usage, 3 if the project could
+// not be opened.
+int run_cli(int argc, char** argv, GpuScalerFactory make_gpu_scaler = nullptr);
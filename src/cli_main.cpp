@@ -0,0 +1,7 @@
+#include "cli.h"
+
+// chya_cli: the command-line modes of chya without the editor, for render hosts with no GL or display.
+// --render --gpu falls back to the CPU, as it does when no OpenGL context can be created.
+int main(int argc, char** argv) {
+  return run_cli(argc, argv, nullptr);
+}
@@ -0,0 +1,209 @@
+#include "composite.h"
+#include <cstdint>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64)
+#define CHYA_COMPOSITE_X86 1
+#include <immintrin.h>
+#endif
+#if defined(CHYA_COMPOSITE_X86) && (defined(__GNUC__) || defined(__clang__))
+#define CHYA_COMPOSITE_AVX2 1
+#endif
+
+namespace {
+
+// x / 255 rounded to nearest, exact for x <= 255 * 255.
+inline int div255(int x) {
+  x += 128;
+  return (x + (x >> 8)) >> 8;
+}
+
+void premultiply_scalar(unsigned char* px, size_t begin, size_t end) {
+  for (size_t i = begin; i < end; i++) {
+    unsigned char* p = px + i * 4;
+    const int a = p[3];
+    for (int c = 0; c < 3; c++) p[c] = static_cast<unsigned char>(div255(p[c] * a));
+  }
+}
+
+void blend_scalar(const unsigned char* top, const unsigned char* bottom, unsigned char* out, size_t begin, size_t end) {
+  for (size_t i = begin; i < end; i++) {
+    const int inv = 255 - top[i * 4 + 3];
+    for (int c = 0; c < 4; c++) {
+      const int v = top[i * 4 + c] + div255(bottom[i * 4 + c] * inv);
+      out[i * 4 + c] = static_cast<unsigned char>(v > 255 ? 255 : v);
+    }
+  }
+}
+
+#if defined(CHYA_COMPOSITE_X86)
+// Two pixels as 16-bit lanes (r g b a r g b a); each lane gets its pixel's alpha.
+inline __m128i broadcast_alpha(__m128i px16) {
+  return _mm_shufflehi_epi16(_mm_shufflelo_epi16(px16, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+}
+
+inline __m128i div255_epu16(__m128i x) {
+  x = _mm_add_epi16(x, _mm_set1_epi16(128));
+  return _mm_srli_epi16(_mm_add_epi16(x, _mm_srli_epi16(x, 8)), 8);
+}
+
+// 4 pixels per step. The alpha lanes are multiplied by 255, which div255 maps back to alpha.
+void premultiply_sse2(unsigned char* px, size_t begin, size_t end) {
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i alpha_lanes = _mm_set_epi16(-1, 0, 0, 0, -1, 0, 0, 0);
+  const __m128i alpha_255 = _mm_and_si128(alpha_lanes, _mm_set1_epi16(255));
+  size_t i = begin;
+  for (; i + 4 <= end; i += 4) {
+    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(px + i * 4));
+    __m128i lo = _mm_unpacklo_epi8(v, zero);
+    __m128i hi = _mm_unpackhi_epi8(v, zero);
+    __m128i mlo = _mm_or_si128(_mm_andnot_si128(alpha_lanes, broadcast_alpha(lo)), alpha_255);
+    __m128i mhi = _mm_or_si128(_mm_andnot_si128(alpha_lanes, broadcast_alpha(hi)), alpha_255);
+    lo = div255_epu16(_mm_mullo_epi16(lo, mlo));
+    hi = div255_epu16(_mm_mullo_epi16(hi, mhi));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(px + i * 4), _mm_packus_epi16(lo, hi));
+  }
+  premultiply_scalar(px, i, end);
+}
+
+void blend_sse2(const unsigned char* top, const unsigned char* bottom, unsigned char* out, size_t begin, size_t end) {
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i max = _mm_set1_epi16(255);
+  size_t i = begin;
+  for (; i + 4 <= end; i += 4) {
+    __m128i t = _mm_loadu_si128(reinterpret_cast<const __m128i*>(top + i * 4));
+    __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(bottom + i * 4));
+    __m128i inv_lo = _mm_sub_epi16(max, broadcast_alpha(_mm_unpacklo_epi8(t, zero)));
+    __m128i inv_hi = _mm_sub_epi16(max, broadcast_alpha(_mm_unpackhi_epi8(t, zero)));
+    __m128i lo = div255_epu16(_mm_mullo_epi16(_mm_unpacklo_epi8(b, zero), inv_lo));
+    __m128i hi = div255_epu16(_mm_mullo_epi16(_mm_unpackhi_epi8(b, zero), inv_hi));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i * 4), _mm_adds_epu8(t, _mm_packus_epi16(lo, hi)));
+  }
+  blend_scalar(top, bottom, out, i, end);
+}
+#endif
+
+#if defined(CHYA_COMPOSITE_AVX2)
+// Same as the SSE2 kernels on 8 pixels per step; unpack/pack stay within 128-bit lanes, keeping pixel order.
+__attribute__((target("avx2")))
+inline __m256i broadcast_alpha_avx2(__m256i px16) {
+  return _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(px16, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+}
+
+__attribute__((target("avx2")))
+inline __m256i div255_epu16_avx2(__m256i x) {
+  x = _mm256_add_epi16(x, _mm256_set1_epi16(128));
+  return _mm256_srli_epi16(_mm256_add_epi16(x, _mm256_srli_epi16(x, 8)), 8);
+}
+
+__attribute__((target("avx2")))
+void premultiply_avx2(unsigned char* px, size_t begin, size_t end) {
+  const __m256i zero = _mm256_setzero_si256();
+  const __m256i alpha_lanes = _mm256_set_epi16(-1, 0, 0, 0, -1, 0, 0, 0, -1, 0, 0, 0, -1, 0, 0, 0);
+  const __m256i alpha_255 = _mm256_and_si256(alpha_lanes, _mm256_set1_epi16(255));
+  size_t i = begin;
+  for (; i + 8 <= end; i += 8) {
+    __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(px + i * 4));
+    __m256i lo = _mm256_unpacklo_epi8(v, zero);
+    __m256i hi = _mm256_unpackhi_epi8(v, zero);
+    __m256i mlo = _mm256_or_si256(_mm256_andnot_si256(alpha_lanes, broadcast_alpha_avx2(lo)), alpha_255);
+    __m256i mhi = _mm256_or_si256(_mm256_andnot_si256(alpha_lanes, broadcast_alpha_avx2(hi)), alpha_255);
+    lo = div255_epu16_avx2(_mm256_mullo_epi16(lo, mlo));
+    hi = div255_epu16_avx2(_mm256_mullo_epi16(hi, mhi));
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(px + i * 4), _mm256_packus_epi16(lo, hi));
+  }
+  premultiply_sse2(px, i, end);
+}
+
+__attribute__((target("avx2")))
+void blend_avx2(const unsigned char* top, const unsigned char* bottom, unsigned char* out, size_t begin, size_t end) {
+  const __m256i zero = _mm256_setzero_si256();
+  const __m256i max = _mm256_set1_epi16(255);
+  size_t i = begin;
+  for (; i + 8 <= end; i += 8) {
+    __m256i t = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(top + i * 4));
+    __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(bottom + i * 4));
+    __m256i inv_lo = _mm256_sub_epi16(max, broadcast_alpha_avx2(_mm256_unpacklo_epi8(t, zero)));
+    __m256i inv_hi = _mm256_sub_epi16(max, broadcast_alpha_avx2(_mm256_unpackhi_epi8(t, zero)));
+    __m256i lo = div255_epu16_avx2(_mm256_mullo_epi16(_mm256_unpacklo_epi8(b, zero), inv_lo));
+    __m256i hi = div255_epu16_avx2(_mm256_mullo_epi16(_mm256_unpackhi_epi8(b, zero), inv_hi));
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i * 4), _mm256_adds_epu8(t, _mm256_packus_epi16(lo, hi)));
+  }
+  blend_sse2(top, bottom, out, i, end);
+}
+
+bool cpu_has_avx2() {
+  static const bool has = __builtin_cpu_supports("avx2");
+  return has;
+}
+#endif
+
+}  // namespace
+
+void premultiply_rgba(unsigned char* px, size_t pixel_count) {
+#if defined(CHYA_COMPOSITE_AVX2)
+  if (cpu_has_avx2()) {
+    premultiply_avx2(px, 0, pixel_count);
+    return;
+  }
+#endif
+#if defined(CHYA_COMPOSITE_X86)
+  premultiply_sse2(px, 0, pixel_count);
+#else
+  premultiply_scalar(px, 0, pixel_count);
+#endif
+}
+
+void blend_over(const unsigned char* top, const unsigned char* bottom, unsigned char* out, size_t pixel_count) {
+#if defined(CHYA_COMPOSITE_AVX2)
+  if (cpu_has_avx2()) {
+    blend_avx2(top, bottom, out, 0, pixel_count);
+    return;
+  }
+#endif
+#if defined(CHYA_COMPOSITE_X86)
+  blend_sse2(top, bottom, out, 0, pixel_count);
+#else
+  blend_scalar(top, bottom, out, 0, pixel_count);
+#endif
+}
+
+void premultiply_rgba_reference(unsigned char* px, size_t pixel_count) {
+  premultiply_scalar(px, 0, pixel_count);
+}
+
+void blend_over_reference(const unsigned char* top, const unsigned char* bottom, unsigned char* out, size_t pixel_count) {
+  blend_scalar(top, bottom, out, 0, pixel_count);
+}
+
+void composite_layers(LayerImage* layers, int count, unsigned char* dst, int dst_w, int dst_h, ScaleMode mode,
+                      std::vector<unsigned char>* scratch) {
+  if (!dst || dst_w <= 0 || dst_h <= 0) return;
+  const size_t pixels = static_cast<size_t>(dst_w) * dst_h;
+  const size_t frame_bytes = pixels * 4;
+  int drawn = 0;
+  for (int i = 0; i < count; i++)
+    if (layers[i].pixels && layers[i].w > 0 && layers[i].h > 0) drawn++;
+  if (drawn == 0) {
+    std::memset(dst, 0, frame_bytes);
+    return;
+  }
+  // A single layer is resampled straight into dst. Otherwise layers accumulate in the first half of scratch
+  // and the topmost one is blended into dst.
+  if (drawn > 1 && scratch->size() < frame_bytes * 2) scratch->resize(frame_bytes * 2);
+  unsigned char* acc = drawn > 1 ? scratch->data() : dst;
+  unsigned char* layer = drawn > 1 ? scratch->data() + frame_bytes : nullptr;
+  int done = 0;
+  for (int i = 0; i < count; i++) {
+    LayerImage& L = layers[i];
+    if (!L.pixels || L.w <= 0 || L.h <= 0) continue;
+    premultiply_rgba(L.pixels, static_cast<size_t>(L.w) * L.h);
+    if (done == 0) {
+      resample_rgba(L.pixels, L.w, L.h, acc, dst_w, dst_h, mode);
+    } else {
+      resample_rgba(L.pixels, L.w, L.h, layer, dst_w, dst_h, mode);
+      blend_over(layer, acc, done + 1 == drawn ? dst : acc, pixels);
+    }
+    done++;
+  }
+}
@@ -0,0 +1,30 @@
+#pragma once
+#include <cstddef>
+#include <vector>
+#include "resample.h"
+
+// Alpha compositing of layer images into output frames. Frames are premultiplied RGBA8; to an encoder or
+// display that ignores alpha that is the picture over black.
+
+// One decoded layer image, straight (not premultiplied) RGBA8.
+struct LayerImage {
+  unsigned char* pixels = nullptr;
+  int w = 0;
+  int h = 0;
+};
+
+// Multiplies colour by alpha in place, rounded to nearest.
+void premultiply_rgba(unsigned char* px, size_t pixel_count);
+// out = top over bottom, all premultiplied. out may alias top or bottom.
+// AVX2/SSE2 kernels are picked at runtime with a scalar fallback, as in resample_rgba.
+void blend_over(const unsigned char* top, const unsigned char* bottom, unsigned char* out, size_t pixel_count);
+// Scalar implementations of premultiply_rgba and blend_over. The SIMD kernels match them exactly;
+// `chya --self-check` compares them at pixel counts that reach every kernel and its remainder.
+void premultiply_rgba_reference(unsigned char* px, size_t pixel_count);
+void blend_over_reference(const unsigned char* top, const unsigned char* bottom, unsigned char* out, size_t pixel_count);
+
+// Composites layers bottom to top into dst (dst_w * dst_h * 4 bytes, every byte written, transparent black
+// where no layer covers). Each layer is premultiplied in place, then resampled with mode and blended. dst is
+// written but never read, so it may be mapped GPU memory. scratch holds intermediates between calls.
+void composite_layers(LayerImage* layers, int count, unsigned char* dst, int dst_w, int dst_h, ScaleMode mode,
+                      std::vector<unsigned char>* scratch);
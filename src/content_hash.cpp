@@ -0,0 +1,98 @@
+#include "content_hash.h"
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+constexpr uint64_t kPrime1 = 0x9e3779b185ebca87ull;
+constexpr uint64_t kPrime2 = 0xc2b2ae3d27d4eb4full;
+constexpr uint64_t kPrime3 = 0x165667b19e3779f9ull;
+constexpr uint64_t kPrime4 = 0x85ebca77c2b2ae63ull;
+constexpr uint64_t kPrime5 = 0x27d4eb2f165667c5ull;
+
+inline uint64_t rotl(uint64_t x, int r) {
+  return (x << r) | (x >> (64 - r));
+}
+
+// Little-endian loads, so the digest is the same on every host.
+inline uint64_t read64(const unsigned char* p) {
+  uint64_t v = 0;
+  for (int i = 7; i >= 0; i--) v = (v << 8) | p[i];
+  return v;
+}
+
+inline uint32_t read32(const unsigned char* p) {
+  return static_cast<uint32_t>(p[0]) | static_cast<uint32_t>(p[1]) << 8 | static_cast<uint32_t>(p[2]) << 16 |
+         static_cast<uint32_t>(p[3]) << 24;
+}
+
+inline uint64_t round(uint64_t acc, uint64_t input) {
+  acc += input * kPrime2;
+  return rotl(acc, 31) * kPrime1;
+}
+
+inline uint64_t merge_round(uint64_t acc, uint64_t val) {
+  acc ^= round(0, val);
+  return acc * kPrime1 + kPrime4;
+}
+
+}  // namespace
+
+void ContentHasher::update(const void* data, size_t size) {
+  const unsigned char* p = static_cast<const unsigned char*>(data);
+  total_ += size;
+  if (buf_len_ > 0) {
+    const size_t take = std::min(size, sizeof(buf_) - buf_len_);
+    std::memcpy(buf_ + buf_len_, p, take);
+    buf_len_ += take;
+    p += take;
+    size -= take;
+    if (buf_len_ < sizeof(buf_)) return;
+    for (int i = 0; i < 4; i++) acc_[i] = round(acc_[i], read64(buf_ + i * 8));
+    buf_len_ = 0;
+  }
+  for (; size >= 32; p += 32, size -= 32)
+    for (int i = 0; i < 4; i++) acc_[i] = round(acc_[i], read64(p + i * 8));
+  std::memcpy(buf_, p, size);
+  buf_len_ = size;
+}
+
+uint64_t ContentHasher::digest() const {
+  uint64_t h;
+  if (total_ >= 32) {
+    h = rotl(acc_[0], 1) + rotl(acc_[1], 7) + rotl(acc_[2], 12) + rotl(acc_[3], 18);
+    for (int i = 0; i < 4; i++) h = merge_round(h, acc_[i]);
+  } else {
+    h = acc_[2] + kPrime5;  // acc_[2] still holds the seed
+  }
+  h += total_;
+  const unsigned char* p = buf_;
+  size_t n = buf_len_;
+  for (; n >= 8; p += 8, n -= 8) {
+    h ^= round(0, read64(p));
+    h = rotl(h, 27) * kPrime1 + kPrime4;
+  }
+  if (n >= 4) {
+    h ^= static_cast<uint64_t>(read32(p)) * kPrime1;
+    h = rotl(h, 23) * kPrime2 + kPrime3;
+    p += 4;
+    n -= 4;
+  }
+  for (; n > 0; p++, n--) {
+    h ^= *p * kPrime5;
+    h = rotl(h, 11) * kPrime1;
+  }
+  h ^= h >> 33;
+  h *= kPrime2;
+  h ^= h >> 29;
+  h *= kPrime3;
+  h ^= h >> 32;
+  return h;
+}
+
+std::string content_hash_hex(uint64_t hash) {
+  static const char kDigits[] = "0123456789abcdef";
+  std::string s(16, '0');
+  for (int i = 15; i >= 0; i--, hash >>= 4) s[i] = kDigits[hash & 15];
+  return s;
+}
@@ -0,0 +1,22 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Streaming 64-bit content hash (XXH64, seed 0) for naming and deduplicating media files. Fast enough to run
+// inline with a copy at disk speed; not a cryptographic hash.
+class ContentHasher {
+ public:
+  void update(const void* data, size_t size);
+  uint64_t digest() const;
+
+ private:
+  // seed + prime1 + prime2, seed + prime2, seed, seed - prime1 (seed 0)
+  uint64_t acc_[4] = {0x60ea27eeadc0b5d6ull, 0xc2b2ae3d27d4eb4full, 0ull, 0x61c8864e7a143579ull};
+  unsigned char buf_[32];
+  size_t buf_len_ = 0;
+  uint64_t total_ = 0;
+};
+
+// 16 lowercase hex digits.
+std::string content_hash_hex(uint64_t hash);
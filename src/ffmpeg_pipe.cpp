@@ -0,0 +1,154 @@
+#include "ffmpeg_pipe.h"
+#include <cerrno>
+#include <csignal>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <spawn.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <vector>
+
+extern char** environ;
+
+namespace {
+
+// Starts ffmpeg with stdin read from stdin_fd (or /dev/null when negative) and stdout/stderr discarded.
+bool spawn_ffmpeg(std::vector<std::string> args, int stdin_fd, pid_t* pid, std::string* error) {
+  std::vector<char*> argv;
+  for (std::string& a : args) argv.push_back(a.data());
+  argv.push_back(nullptr);
+
+  posix_spawn_file_actions_t actions;
+  posix_spawn_file_actions_init(&actions);
+  if (stdin_fd >= 0) {
+    posix_spawn_file_actions_adddup2(&actions, stdin_fd, STDIN_FILENO);
+    posix_spawn_file_actions_addclose(&actions, stdin_fd);
+  } else {
+    posix_spawn_file_actions_addopen(&actions, STDIN_FILENO, "/dev/null", O_RDONLY, 0);
+  }
+  posix_spawn_file_actions_addopen(&actions, STDOUT_FILENO, "/dev/null", O_WRONLY, 0);
+  posix_spawn_file_actions_addopen(&actions, STDERR_FILENO, "/dev/null", O_WRONLY, 0);
+  int r = posix_spawnp(pid, "ffmpeg", &actions, nullptr, argv.data(), environ);
+  posix_spawn_file_actions_destroy(&actions);
+  if (r != 0) {
+    *pid = -1;
+    *error = (r == ENOENT) ? std::string("ffmpeg was not found in PATH") : std::string("Could not start ffmpeg: ") + std::strerror(r);
+    return false;
+  }
+  return true;
+}
+
+// Waits for ffmpeg. Returns true only if it exited with status 0; otherwise appends the reason to *error.
+bool wait_ffmpeg(pid_t pid, std::string* error) {
+  int status = 0;
+  pid_t r;
+  do {
+    r = waitpid(pid, &status, 0);
+  } while (r < 0 && errno == EINTR);
+  if (r < 0) {
+    *error = std::string("waitpid: ") + std::strerror(errno);
+    return false;
+  }
+  if (WIFEXITED(status) && WEXITSTATUS(status) == 0)
+    return error->empty();
+  char buf[128];
+  if (WIFEXITED(status))
+    snprintf(buf, sizeof(buf), "ffmpeg exited with status %d", WEXITSTATUS(status));
+  else
+    snprintf(buf, sizeof(buf), "ffmpeg was terminated by signal %d", WIFSIGNALED(status) ? WTERMSIG(status) : 0);
+  *error = error->empty() ? std::string(buf) : *error + " (" + buf + ")";
+  return false;
+}
+
+}  // namespace
+
+FfmpegPipe::~FfmpegPipe() {
+  finish();
+}
+
+bool FfmpegPipe::open(const std::string& output_path, int width, int height, double frame_rate) {
+  if (pid_ > 0 || width <= 0 || height <= 0 || frame_rate <= 0.) return false;
+  // A dead reader must surface as EPIPE from write(), not terminate the app.
+  std::signal(SIGPIPE, SIG_IGN);
+  int fds[2];
+  if (pipe(fds) != 0) {
+    error_ = std::string("pipe: ") + std::strerror(errno);
+    return false;
+  }
+  fcntl(fds[1], F_SETFD, FD_CLOEXEC);
+
+  char size_arg[32];
+  char rate_arg[32];
+  snprintf(size_arg, sizeof(size_arg), "%dx%d", width, height);
+  snprintf(rate_arg, sizeof(rate_arg), "%g", frame_rate);
+  std::vector<std::string> args = {
+      "ffmpeg", "-y", "-loglevel", "error",
+      "-f", "rawvideo", "-pix_fmt", "rgba", "-s", size_arg, "-framerate", rate_arg, "-i", "-",
+      "-c:v", "libx264", "-pix_fmt", "yuv420p", output_path};
+  error_.clear();
+  const bool spawned = spawn_ffmpeg(std::move(args), fds[0], &pid_, &error_);
+  close(fds[0]);
+  if (!spawned) {
+    close(fds[1]);
+    return false;
+  }
+  fd_ = fds[1];
+  frame_bytes_ = static_cast<size_t>(width) * height * 4;
+  return true;
+}
+
+bool FfmpegPipe::write_frame(const unsigned char* rgba) {
+  if (fd_ < 0 || !rgba) return false;
+  size_t off = 0;
+  while (off < frame_bytes_) {
+    ssize_t n = write(fd_, rgba + off, frame_bytes_ - off);
+    if (n < 0) {
+      if (errno == EINTR) continue;
+      error_ = (errno == EPIPE) ? std::string("ffmpeg stopped reading frames") : std::string("Writing to ffmpeg failed: ") + std::strerror(errno);
+      close(fd_);
+      fd_ = -1;
+      return false;
+    }
+    off += static_cast<size_t>(n);
+  }
+  return true;
+}
+
+bool FfmpegPipe::finish() {
+  if (fd_ >= 0) {
+    close(fd_);
+    fd_ = -1;
+  }
+  if (pid_ <= 0) return false;
+  const pid_t pid = pid_;
+  pid_ = -1;
+  return wait_ffmpeg(pid, &error_);
+}
+
+bool concat_videos(const std::vector<std::string>& inputs, const std::string& list_path, const std::string& output_path, std::string* error) {
+  std::string err;
+  if (inputs.empty()) err = "Nothing to join";
+  {
+    std::ofstream list(list_path, std::ios::trunc);
+    // Paths are single-quoted for the concat demuxer; a quote inside one is written as '\''.
+    for (const std::string& in : inputs) {
+      list << "file '";
+      for (char c : in) {
+        if (c == '\'') list << "'\\''";
+        else list << c;
+      }
+      list << "'\n";
+    }
+    if (err.empty() && !list) err = "Could not write " + list_path;
+  }
+  pid_t pid = -1;
+  bool ok = err.empty() &&
+            spawn_ffmpeg({"ffmpeg", "-y", "-loglevel", "error", "-f", "concat", "-safe", "0", "-i", list_path, "-c", "copy", output_path},
+                         -1, &pid, &err) &&
+            wait_ffmpeg(pid, &err);
+  std::remove(list_path.c_str());
+  if (!ok && error) *error = err;
+  return ok;
+}
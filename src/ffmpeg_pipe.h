@@ -0,0 +1,33 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <sys/types.h>
+
+// ffmpeg child process that encodes raw RGBA frames written to its stdin.
+// Frames must be exactly width * height * 4 bytes and are encoded in the order they are written.
+class FfmpegPipe {
+ public:
+  FfmpegPipe() = default;
+  FfmpegPipe(const FfmpegPipe&) = delete;
+  FfmpegPipe& operator=(const FfmpegPipe&) = delete;
+  ~FfmpegPipe();
+
+  // Starts ffmpeg writing an H.264 video to output_path. Returns false (see error()) if it could not be spawned.
+  bool open(const std::string& output_path, int width, int height, double frame_rate);
+  // Writes one frame. Returns false if ffmpeg stopped reading (e.g. it exited after an encode error).
+  bool write_frame(const unsigned char* rgba);
+  // Closes ffmpeg's stdin and waits for it. Returns true only if ffmpeg exited with status 0.
+  bool finish();
+
+  const std::string& error() const { return error_; }
+
+ private:
+  pid_t pid_ = -1;
+  int fd_ = -1;
+  size_t frame_bytes_ = 0;
+  std::string error_;
+};
+
+// Joins videos written by FfmpegPipe with identical size and frame rate into output_path without re-encoding
+// (ffmpeg's concat demuxer, stream copy). list_path is a scratch file for the input list, removed afterwards.
+bool concat_videos(const std::vector<std::string>& inputs, const std::string& list_path, const std::string& output_path, std::string* error = nullptr);
@@ -0,0 +1,111 @@
+#include "gl_util.h"
+#include <GLFW/glfw3.h>
+#include <cstdio>
+#include <mutex>
+
+#ifndef GL_STATIC_DRAW
+#define GL_STATIC_DRAW 0x88E4
+#endif
+
+namespace {
+
+const char* kQuadVs = "#version 330\n"
+  "layout(location=0) in vec2 pos;\n"
+  "out vec2 uv;\n"
+  "void main() { gl_Position = vec4(pos, 0, 1); uv = pos*0.5+0.5; }\n";
+const char* kQuadFs = "#version 330\n"
+  "in vec2 uv; uniform sampler2D tex; out vec4 fragColor;\n"
+  "void main() { fragColor = texture(tex, vec2(uv.x, 1.0 - uv.y)); }\n";
+
+template <typename Fn>
+bool load_proc(Fn& fn, const char* name) {
+  fn = reinterpret_cast<Fn>(glfwGetProcAddress(name));
+  return fn != nullptr;
+}
+
+}  // namespace
+
+const GlExtra* gl_extra() {
+  static GlExtra gl;
+  static bool ok = false;
+  static std::once_flag once;
+  std::call_once(once, [] {
+    ok = load_proc(gl.DrawArrays, "glDrawArrays") &&
+         load_proc(gl.TexSubImage2D, "glTexSubImage2D") &&
+         load_proc(gl.MapBufferRange, "glMapBufferRange") &&
+         load_proc(gl.UnmapBuffer, "glUnmapBuffer") &&
+         load_proc(gl.ReadPixels, "glReadPixels") &&
+         load_proc(gl.GenFramebuffers, "glGenFramebuffers") &&
+         load_proc(gl.DeleteFramebuffers, "glDeleteFramebuffers") &&
+         load_proc(gl.BindFramebuffer, "glBindFramebuffer") &&
+         load_proc(gl.FramebufferTexture2D, "glFramebufferTexture2D") &&
+         load_proc(gl.CheckFramebufferStatus, "glCheckFramebufferStatus") &&
+         load_proc(gl.FenceSync, "glFenceSync") &&
+         load_proc(gl.ClientWaitSync, "glClientWaitSync") &&
+         load_proc(gl.DeleteSync, "glDeleteSync") &&
+         load_proc(gl.Uniform2f, "glUniform2f") &&
+         load_proc(gl.Uniform2i, "glUniform2i");
+  });
+  return ok ? &gl : nullptr;
+}
+
+GLuint create_program(const char* vertex_src, const char* fragment_src) {
+  GLuint vs = glCreateShader(GL_VERTEX_SHADER);
+  glShaderSource(vs, 1, &vertex_src, nullptr);
+  glCompileShader(vs);
+  GLuint fs = glCreateShader(GL_FRAGMENT_SHADER);
+  glShaderSource(fs, 1, &fragment_src, nullptr);
+  glCompileShader(fs);
+  GLuint program = glCreateProgram();
+  glAttachShader(program, vs);
+  glAttachShader(program, fs);
+  glLinkProgram(program);
+  glDeleteShader(vs);
+  glDeleteShader(fs);
+  GLint linked = 0;
+  glGetProgramiv(program, GL_LINK_STATUS, &linked);
+  if (!linked) {
+    char log[1024] = "";
+    glGetProgramInfoLog(program, sizeof(log), nullptr, log);
+    std::fprintf(stderr, "chya: shader link failed: %s\n", log);
+    glDeleteProgram(program);
+    return 0;
+  }
+  return program;
+}
+
+bool create_quad_renderer(QuadRenderer* quad) {
+  if (!gl_extra()) return false;
+  quad->program = create_program(kQuadVs, kQuadFs);
+
+  float verts[] = {-1,-1, 1,-1, -1,1,  -1,1, 1,-1, 1,1};
+  glGenVertexArrays(1, &quad->vao);
+  glGenBuffers(1, &quad->vbo);
+  glBindVertexArray(quad->vao);
+  glBindBuffer(GL_ARRAY_BUFFER, quad->vbo);
+  glBufferData(GL_ARRAY_BUFFER, sizeof(verts), verts, GL_STATIC_DRAW);
+  glEnableVertexAttribArray(0);
+  glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 0, nullptr);
+  glBindVertexArray(0);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+  return quad->program != 0;
+}
+
+void destroy_quad_renderer(QuadRenderer* quad) {
+  if (quad->vao != 0) glDeleteVertexArrays(1, &quad->vao);
+  if (quad->vbo != 0) glDeleteBuffers(1, &quad->vbo);
+  if (quad->program != 0) glDeleteProgram(quad->program);
+  *quad = QuadRenderer();
+}
+
+void draw_textured_quad(const QuadRenderer& quad, GLuint texture_id) {
+  const GlExtra* gl = gl_extra();
+  if (!gl || quad.program == 0) return;
+  glUseProgram(quad.program);
+  glActiveTexture(GL_TEXTURE0);
+  glBindTexture(GL_TEXTURE_2D, texture_id);
+  glUniform1i(glGetUniformLocation(quad.program, "tex"), 0);
+  glBindVertexArray(quad.vao);
+  gl->DrawArrays(GL_TRIANGLES, 0, 6);
+  glBindVertexArray(0);
+}
@@ -0,0 +1,89 @@
+#pragma once
+#include "imgui_impl_opengl3_loader.h"
+
+#ifndef GL_PIXEL_UNPACK_BUFFER
+#define GL_PIXEL_UNPACK_BUFFER 0x88EC
+#endif
+#ifndef GL_MAP_WRITE_BIT
+#define GL_MAP_WRITE_BIT 0x0002
+#endif
+#ifndef GL_MAP_INVALIDATE_BUFFER_BIT
+#define GL_MAP_INVALIDATE_BUFFER_BIT 0x0008
+#endif
+#ifndef GL_PIXEL_PACK_BUFFER
+#define GL_PIXEL_PACK_BUFFER 0x88EB
+#endif
+#ifndef GL_STREAM_READ
+#define GL_STREAM_READ 0x88E1
+#endif
+#ifndef GL_MAP_READ_BIT
+#define GL_MAP_READ_BIT 0x0001
+#endif
+#ifndef GL_FRAMEBUFFER
+#define GL_FRAMEBUFFER 0x8D40
+#endif
+#ifndef GL_COLOR_ATTACHMENT0
+#define GL_COLOR_ATTACHMENT0 0x8CE0
+#endif
+#ifndef GL_FRAMEBUFFER_COMPLETE
+#define GL_FRAMEBUFFER_COMPLETE 0x8CD5
+#endif
+#ifndef GL_SYNC_GPU_COMMANDS_COMPLETE
+#define GL_SYNC_GPU_COMMANDS_COMPLETE 0x9117
+#endif
+#ifndef GL_SYNC_FLUSH_COMMANDS_BIT
+#define GL_SYNC_FLUSH_COMMANDS_BIT 0x00000001
+#endif
+#ifndef GL_WAIT_FAILED
+#define GL_WAIT_FAILED 0x911D
+#endif
+#ifndef GL_TIMEOUT_EXPIRED
+#define GL_TIMEOUT_EXPIRED 0x911B
+#endif
+#ifndef GL_NEAREST
+#define GL_NEAREST 0x2600
+#endif
+#ifndef GL_RGBA8
+#define GL_RGBA8 0x8058
+#endif
+#ifndef GL_MAX_TEXTURE_SIZE
+#define GL_MAX_TEXTURE_SIZE 0x0D33
+#endif
+
+using GlSync = struct __GLsync*;
+
+// GL 3.3 entry points that imgui_impl_opengl3_loader.h does not expose, loaded with glfwGetProcAddress.
+struct GlExtra {
+  void (*DrawArrays)(GLenum mode, GLint first, GLsizei count) = nullptr;
+  void (*TexSubImage2D)(GLenum target, GLint level, GLint x, GLint y, GLsizei w, GLsizei h, GLenum format, GLenum type, const void* pixels) = nullptr;
+  void* (*MapBufferRange)(GLenum target, GLintptr offset, GLsizeiptr length, GLbitfield access) = nullptr;
+  GLboolean (*UnmapBuffer)(GLenum target) = nullptr;
+  void (*ReadPixels)(GLint x, GLint y, GLsizei w, GLsizei h, GLenum format, GLenum type, void* pixels) = nullptr;
+  void (*GenFramebuffers)(GLsizei n, GLuint* ids) = nullptr;
+  void (*DeleteFramebuffers)(GLsizei n, const GLuint* ids) = nullptr;
+  void (*BindFramebuffer)(GLenum target, GLuint id) = nullptr;
+  void (*FramebufferTexture2D)(GLenum target, GLenum attachment, GLenum tex_target, GLuint texture, GLint level) = nullptr;
+  GLenum (*CheckFramebufferStatus)(GLenum target) = nullptr;
+  GlSync (*FenceSync)(GLenum condition, GLbitfield flags) = nullptr;
+  GLenum (*ClientWaitSync)(GlSync sync, GLbitfield flags, GLuint64 timeout) = nullptr;
+  void (*DeleteSync)(GlSync sync) = nullptr;
+  void (*Uniform2f)(GLint location, GLfloat x, GLfloat y) = nullptr;
+  void (*Uniform2i)(GLint location, GLint x, GLint y) = nullptr;
+};
+// Loads GlExtra on first use; a GL context must be current. Returns nullptr if an entry point is missing.
+const GlExtra* gl_extra();
+
+// Compiles and links a vertex + fragment shader pair. Returns 0 (after logging to stderr) on failure.
+GLuint create_program(const char* vertex_src, const char* fragment_src);
+
+// Shader and full-viewport quad for drawing a texture. Vertex arrays are not shared between contexts, so
+// create one per context and use it only there.
+struct QuadRenderer {
+  GLuint program = 0;
+  GLuint vao = 0;
+  GLuint vbo = 0;
+};
+bool create_quad_renderer(QuadRenderer* quad);
+void destroy_quad_renderer(QuadRenderer* quad);
+// Draws texture_id over the current viewport.
+void draw_textured_quad(const QuadRenderer& quad, GLuint texture_id);
@@ -0,0 +1,238 @@
+#include "gpu_export.h"
+#include <GLFW/glfw3.h>
+#include "gl_util.h"
+#include <cstring>
+
+namespace {
+
+// Frames drawn ahead of the oldest unfinished readback.
+constexpr int kReadbackDepth = 3;
+// A readback still pending after this many 100 ms waits is treated as a hung GPU.
+constexpr int kReadbackWaits = 50;
+
+// Full-screen triangle from gl_VertexID; no vertex buffer needed.
+const char* kScaleVs = "#version 330\n"
+  "void main() {\n"
+  "  vec2 p = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);\n"
+  "  gl_Position = vec4(p * 2.0 - 1.0, 0, 1);\n"
+  "}\n";
+// Per axis, matches filter_taps in resample.cpp: area average over [off + i*scale, +scale) when shrinking,
+// bilinear around off + (i+0.5)*scale - 0.5 when growing; indices clamped to the image. Texels are
+// premultiplied with the same 8-bit rounding as premultiply_rgba before filtering. Filtering in float and
+// blending in the framebuffer keep frames within kFrameScalerTolerance of composite_layers, not exact.
+// Framebuffer row y is image row y, so no flip is needed on upload or readback.
+const char* kScaleFs = "#version 330\n"
+  "uniform sampler2D src;\n"
+  "uniform ivec2 dst_origin;\n"
+  "uniform vec2 src_off;\n"
+  "uniform vec2 scale;\n"
+  "out vec4 fragColor;\n"
+  "void taps(float off, float s, int i, out int first, out int last, out float lo, out float hi) {\n"
+  "  if (s > 1.0) { lo = off + float(i) * s; hi = lo + s; first = int(floor(lo)); last = int(ceil(hi)) - 1; }\n"
+  "  else { lo = off + (float(i) + 0.5) * s - 0.5; hi = lo; first = int(floor(lo)); last = first + 1; }\n"
+  "}\n"
+  "float weight(float s, float lo, float hi, int j) {\n"
+  "  if (s > 1.0) return max(min(hi, float(j + 1)) - max(lo, float(j)), 0.0) / s;\n"
+  "  float f = lo - floor(lo);\n"
+  "  return j == int(floor(lo)) ? 1.0 - f : f;\n"
+  "}\n"
+  "void main() {\n"
+  "  ivec2 i = ivec2(gl_FragCoord.xy) - dst_origin;\n"
+  "  ivec2 size = textureSize(src, 0);\n"
+  "  int x0, x1, y0, y1; float xlo, xhi, ylo, yhi;\n"
+  "  taps(src_off.x, scale.x, i.x, x0, x1, xlo, xhi);\n"
+  "  taps(src_off.y, scale.y, i.y, y0, y1, ylo, yhi);\n"
+  "  vec4 acc = vec4(0.0);\n"
+  "  for (int y = y0; y <= y1; y++) {\n"
+  "    float wy = weight(scale.y, ylo, yhi, y);\n"
+  "    if (wy <= 0.0) continue;\n"
+  "    for (int x = x0; x <= x1; x++) {\n"
+  "      float wx = weight(scale.x, xlo, xhi, x);\n"
+  "      if (wx <= 0.0) continue;\n"
+  "      vec4 t = round(texelFetch(src, clamp(ivec2(x, y), ivec2(0), size - 1), 0) * 255.0);\n"
+  "      t.rgb = floor(t.rgb * t.a / 255.0 + 0.5);\n"
+  "      acc += t * (wx * wy);\n"
+  "    }\n"
+  "  }\n"
+  "  fragColor = acc / 255.0;\n"
+  "}\n";
+
+class GlFrameScaler : public FrameScaler {
+ public:
+  explicit GlFrameScaler(GLFWwindow* window) : window_(window) {}
+  ~GlFrameScaler() override { glfwDestroyWindow(window_); }
+
+  bool begin(int out_w, int out_h, ScaleMode mode) override {
+    glfwMakeContextCurrent(window_);
+    gl_ = gl_extra();
+    max_texture_size_ = 0;
+    if (gl_) glGetIntegerv(GL_MAX_TEXTURE_SIZE, &max_texture_size_);
+    if (!gl_ || out_w <= 0 || out_h <= 0 || out_w > max_texture_size_ || out_h > max_texture_size_) {
+      glfwMakeContextCurrent(nullptr);
+      return false;
+    }
+    out_w_ = out_w;
+    out_h_ = out_h;
+    mode_ = mode;
+    program_ = create_program(kScaleVs, kScaleFs);
+    glGenVertexArrays(1, &vao_);
+    glGenTextures(1, &src_tex_);
+    glGenTextures(1, &dst_tex_);
+    for (GLuint tex : {src_tex_, dst_tex_}) {
+      glBindTexture(GL_TEXTURE_2D, tex);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    }
+    glBindTexture(GL_TEXTURE_2D, dst_tex_);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, out_w, out_h, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    gl_->GenFramebuffers(1, &fbo_);
+    gl_->BindFramebuffer(GL_FRAMEBUFFER, fbo_);
+    gl_->FramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, dst_tex_, 0);
+    const bool complete = gl_->CheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+    gl_->BindFramebuffer(GL_FRAMEBUFFER, 0);
+    const GLsizeiptr bytes = static_cast<GLsizeiptr>(out_w) * out_h * 4;
+    glGenBuffers(kReadbackDepth, pbos_);
+    for (GLuint pbo : pbos_) {
+      glBindBuffer(GL_PIXEL_PACK_BUFFER, pbo);
+      glBufferData(GL_PIXEL_PACK_BUFFER, bytes, nullptr, GL_STREAM_READ);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    head_ = tail_ = 0;
+    if (program_ == 0 || !complete) {
+      end();
+      return false;
+    }
+    return true;
+  }
+
+  bool submit(const LayerImage* layers, int count) override {
+    if (head_ - tail_ >= kReadbackDepth) return false;
+    // A layer the driver cannot hold as one texture would upload as nothing and draw transparent; fail the
+    // frame instead.
+    for (int i = 0; i < count; i++)
+      if (layers[i].w > max_texture_size_ || layers[i].h > max_texture_size_) return false;
+    gl_->BindFramebuffer(GL_FRAMEBUFFER, fbo_);
+    glViewport(0, 0, out_w_, out_h_);
+    glClearColor(0.f, 0.f, 0.f, 0.f);
+    glClear(GL_COLOR_BUFFER_BIT);
+    glUseProgram(program_);
+    glActiveTexture(GL_TEXTURE0);
+    glUniform1i(glGetUniformLocation(program_, "src"), 0);
+    glBindVertexArray(vao_);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    // Premultiplied "over", bottom layer first, as blend_over.
+    glEnable(GL_BLEND);
+    glBlendEquation(GL_FUNC_ADD);
+    glBlendFuncSeparate(GL_ONE, GL_ONE_MINUS_SRC_ALPHA, GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+    for (int i = 0; i < count; i++) {
+      const LayerImage& L = layers[i];
+      const ScaleRect r = compute_scale_rect(L.w, L.h, out_w_, out_h_, mode_);
+      glBindTexture(GL_TEXTURE_2D, src_tex_);
+      glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, L.w, L.h, 0, GL_RGBA, GL_UNSIGNED_BYTE, L.pixels);
+      glViewport(r.dst_x, r.dst_y, r.dst_w, r.dst_h);
+      gl_->Uniform2i(glGetUniformLocation(program_, "dst_origin"), r.dst_x, r.dst_y);
+      gl_->Uniform2f(glGetUniformLocation(program_, "src_off"), static_cast<float>(r.src_x), static_cast<float>(r.src_y));
+      gl_->Uniform2f(glGetUniformLocation(program_, "scale"), static_cast<float>(r.src_w / r.dst_w), static_cast<float>(r.src_h / r.dst_h));
+      gl_->DrawArrays(GL_TRIANGLES, 0, 3);
+    }
+    glDisable(GL_BLEND);
+    glBindVertexArray(0);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    // Readback into the next pack buffer returns at once; the copy runs after the draw on the GPU.
+    const int slot = head_ % kReadbackDepth;
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, pbos_[slot]);
+    gl_->ReadPixels(0, 0, out_w_, out_h_, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    gl_->BindFramebuffer(GL_FRAMEBUFFER, 0);
+    fences_[slot] = gl_->FenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    glFlush();
+    head_++;
+    return fences_[slot] != nullptr;
+  }
+
+  bool receive(unsigned char* dst) override {
+    if (tail_ == head_) return false;
+    const int slot = tail_ % kReadbackDepth;
+    GLenum status = GL_TIMEOUT_EXPIRED;
+    for (int i = 0; i < kReadbackWaits && status == GL_TIMEOUT_EXPIRED; i++)
+      status = gl_->ClientWaitSync(fences_[slot], GL_SYNC_FLUSH_COMMANDS_BIT, 100000000);  // 100 ms
+    gl_->DeleteSync(fences_[slot]);
+    fences_[slot] = nullptr;
+    tail_++;
+    if (status == GL_WAIT_FAILED || status == GL_TIMEOUT_EXPIRED) return false;
+    const GLsizeiptr bytes = static_cast<GLsizeiptr>(out_w_) * out_h_ * 4;
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, pbos_[slot]);
+    const void* p = gl_->MapBufferRange(GL_PIXEL_PACK_BUFFER, 0, bytes, GL_MAP_READ_BIT);
+    if (p) std::memcpy(dst, p, static_cast<size_t>(bytes));
+    gl_->UnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    return p != nullptr;
+  }
+
+  int depth() const override { return kReadbackDepth; }
+
+  void end() override {
+    for (GlSync& fence : fences_) {
+      if (fence) gl_->DeleteSync(fence);
+      fence = nullptr;
+    }
+    if (pbos_[0] != 0) glDeleteBuffers(kReadbackDepth, pbos_);
+    if (fbo_ != 0) gl_->DeleteFramebuffers(1, &fbo_);
+    if (src_tex_ != 0) glDeleteTextures(1, &src_tex_);
+    if (dst_tex_ != 0) glDeleteTextures(1, &dst_tex_);
+    if (vao_ != 0) glDeleteVertexArrays(1, &vao_);
+    if (program_ != 0) glDeleteProgram(program_);
+    for (GLuint& pbo : pbos_) pbo = 0;
+    fbo_ = src_tex_ = dst_tex_ = vao_ = program_ = 0;
+    glfwMakeContextCurrent(nullptr);
+  }
+
+ private:
+  GLFWwindow* window_;
+  const GlExtra* gl_ = nullptr;
+  int out_w_ = 0;
+  int out_h_ = 0;
+  GLint max_texture_size_ = 0;
+  ScaleMode mode_ = ScaleMode::Fit;
+  GLuint program_ = 0;
+  GLuint vao_ = 0;
+  GLuint src_tex_ = 0;
+  GLuint dst_tex_ = 0;
+  GLuint fbo_ = 0;
+  GLuint pbos_[kReadbackDepth] = {};
+  GlSync fences_[kReadbackDepth] = {};
+  int head_ = 0;  // frames submitted
+  int tail_ = 0;  // frames received
+};
+
+}  // namespace
+
+std::unique_ptr<FrameScaler> create_gpu_frame_scaler() {
+  if (!glfwInit()) return nullptr;
+  glfwDefaultWindowHints();
+  glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+  glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+  glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+#ifdef __APPLE__
+  glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+#endif
+  glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+  GLFWwindow* window = glfwCreateWindow(16, 16, "chya export", nullptr, nullptr);
+  glfwDefaultWindowHints();
+  if (!window) return nullptr;
+  // Core entry points come from ImGui's loader, which ImGui_ImplOpenGL3_Init fills in; `chya --render --gpu`
+  // never initializes ImGui, so load them here (once, on the main thread) while the new context is current.
+  GLFWwindow* previous = glfwGetCurrentContext();
+  glfwMakeContextCurrent(window);
+  static const bool core_loaded = imgl3wInit() == GL3W_OK;
+  const bool loaded = core_loaded && gl_extra() != nullptr;
+  glfwMakeContextCurrent(previous);
+  if (!loaded) {
+    glfwDestroyWindow(window);
+    return nullptr;
+  }
+  return std::make_unique<GlFrameScaler>(window);
+}
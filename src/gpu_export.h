@@ -0,0 +1,11 @@
+#pragma once
+#include <memory>
+#include "render.h"
+
+// FrameScaler that draws each frame's layers into an offscreen framebuffer at the movie size, blending them
+// with premultiplied alpha, and reads it back through a ring of pixel pack buffers, so the readback of one
+// frame overlaps drawing the next. A fragment shader applies the same filters as resample_rgba.
+// Call on the main thread after glfwInit (it creates a hidden window for its own GL context) and destroy
+// the result there as well. Returns nullptr when no window can be created, e.g. on a headless machine, or
+// the OpenGL entry points cannot be loaded.
+std::unique_ptr<FrameScaler> create_gpu_frame_scaler();
@@ -1,24 +1,32 @@
 #define GL_SILENCE_DEPRECATION
-#define STB_IMAGE_IMPLEMENTATION
-#define STB_IMAGE_WRITE_IMPLEMENTATION
 #include "stb_image.h"
-#include "stb_image_write.h"
 #include "backends/imgui_impl_glfw.h"
 #include "backends/imgui_impl_opengl3.h"
 #include "imgui.h"
 #include "imgui_impl_opengl3_loader.h"
 #include <GLFW/glfw3.h>
 #include <sqlite3.h>
+#include "cli.h"
 #include "folder_picker.h"
+#include "gpu_export.h"
+#include "media_import.h"
+#include "project_db.h"
+#include "playback.h"
+#include "project_model.h"
+#include "render.h"
+#include "thumbnails.h"
 #include <algorithm>
 #include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
 #include <fstream>
 #include <cstring>
 #include <filesystem>
-#include <map>
 #include <memory>
 #include <string>
 #include <thread>
+#include <unordered_map>
 #include <vector>
 #if __APPLE__
 #include <mach-o/dyld.h>
@@ -57,15 +65,9 @@ std::string get_executable_dir() {
   return ".";
 }
 
-struct SqliteDeleter {
-  void operator()(sqlite3* p) const {
-    if (p) sqlite3_close(p);
-  }
-};
-using SqliteDb = std::unique_ptr<sqlite3, SqliteDeleter>;
-
 struct CurrentProject {
   SqliteDb db;
+  ProjectModel model;  // cached contents of db; edits go through it
   std::string path;
   std::string name;
 };
@@ -73,12 +75,23 @@ CurrentProject g_project;
 
 GLFWwindow* g_main_window = nullptr;
 GLFWwindow* g_play_window = nullptr;
-double g_play_start_time = 0.;
 int g_play_scene_id = 0;
-GLuint g_quad_program = 0;
+PlaybackEngine g_playback;
+// What g_playback was started with; playback restarts when the scene or config changes.
+uint64_t g_play_scene_revision = 0;
+MovieConfig g_play_config;
+double g_play_title_time = 0.;
+// Copies dropped files into the open project; rows are recorded once the whole batch is done.
+MediaImporter g_media_import;
+int g_media_import_failed = 0;      // files of the last batch that could not be stored or recorded
+int g_media_import_duplicates = 0;  // files of the last batch whose contents were already in the project
+// Brings the media table's metadata in step with the files after a project opens (see revalidate_media).
+std::thread g_media_check_thread;
+std::atomic<bool> g_media_check_cancel(false);
+std::atomic<bool> g_media_check_done(false);
+std::atomic<int> g_media_check_updated(0);
 
 void push_recent_project(const std::string& project_path);
-void clear_thumbnail_cache();
 
 std::string get_default_base_path() {
   const char* home = std::getenv("HOME");
@@ -86,363 +99,101 @@ std::string get_default_base_path() {
   return std::string(home) + "/Documents/chya";
 }
 
-bool run_sql(sqlite3* db, const char* sql) {
-  char* err = nullptr;
-  int r = sqlite3_exec(db, sql, nullptr, nullptr, &err);
-  if (r != SQLITE_OK) {
-    if (err) sqlite3_free(err);
-    return false;
-  }
-  return true;
-}
-
-bool init_schema(sqlite3* db) {
-  const char* schema =
-      "CREATE TABLE IF NOT EXISTS projects("
-      "  id INTEGER PRIMARY KEY, name TEXT NOT NULL, path TEXT NOT NULL);"
-      "CREATE TABLE IF NOT EXISTS timeline("
-      "  id INTEGER PRIMARY KEY);"
-      "CREATE TABLE IF NOT EXISTS scenes("
-      "  id INTEGER PRIMARY KEY, timeline_id INTEGER NOT NULL, sort_order INTEGER NOT NULL, name TEXT);"
-      "CREATE TABLE IF NOT EXISTS layers("
-      "  id INTEGER PRIMARY KEY, scene_id INTEGER NOT NULL, image_path TEXT NOT NULL, sort_order INTEGER NOT NULL);"
-      "CREATE TABLE IF NOT EXISTS media("
-      "  id INTEGER PRIMARY KEY, path TEXT NOT NULL);"
-      "CREATE TABLE IF NOT EXISTS movie_config("
-      "  id INTEGER PRIMARY KEY CHECK (id = 1), duration_sec REAL NOT NULL DEFAULT 10,"
-      "  frame_rate REAL NOT NULL DEFAULT 24, width INTEGER NOT NULL DEFAULT 1920, height INTEGER NOT NULL DEFAULT 1080);";
-  if (!run_sql(db, schema))
-    return false;
-  sqlite3_stmt* stmt = nullptr;
-  if (sqlite3_prepare_v2(db, "SELECT 1 FROM timeline LIMIT 1", -1, &stmt, nullptr) != SQLITE_OK)
-    return false;
-  bool has_timeline = sqlite3_step(stmt) == SQLITE_ROW;
-  sqlite3_finalize(stmt);
-  if (!has_timeline && sqlite3_exec(db, "INSERT INTO timeline(id) VALUES(1)", nullptr, nullptr, nullptr) != SQLITE_OK)
-    return false;
-  sqlite3_exec(db, "ALTER TABLE scenes ADD COLUMN name TEXT", nullptr, nullptr, nullptr);
-  sqlite3_exec(db, "ALTER TABLE layers ADD COLUMN frame_span INTEGER NOT NULL DEFAULT 1", nullptr, nullptr, nullptr);
-  stmt = nullptr;
-  if (sqlite3_prepare_v2(db, "SELECT 1 FROM movie_config LIMIT 1", -1, &stmt, nullptr) == SQLITE_OK) {
-    bool has_config = sqlite3_step(stmt) == SQLITE_ROW;
-    sqlite3_finalize(stmt);
-    if (!has_config)
-      sqlite3_exec(db, "INSERT INTO movie_config(id, duration_sec, frame_rate, width, height) VALUES(1, 10, 24, 1920, 1080)", nullptr, nullptr, nullptr);
-  }
-  return true;
-}
-
-struct MovieConfig {
-  double duration_sec = 10.;
-  double frame_rate = 24.;
-  int width = 1920;
-  int height = 1080;
-};
-MovieConfig get_movie_config(sqlite3* db) {
-  MovieConfig c;
-  if (!db) return c;
-  sqlite3_stmt* stmt = nullptr;
-  if (sqlite3_prepare_v2(db, "SELECT duration_sec, frame_rate, width, height FROM movie_config WHERE id = 1", -1, &stmt, nullptr) != SQLITE_OK)
-    return c;
-  if (sqlite3_step(stmt) == SQLITE_ROW) {
-    c.duration_sec = sqlite3_column_double(stmt, 0);
-    c.frame_rate = sqlite3_column_double(stmt, 1);
-    c.width = sqlite3_column_int(stmt, 2);
-    c.height = sqlite3_column_int(stmt, 3);
-  }
-  sqlite3_finalize(stmt);
-  return c;
-}
-bool set_movie_config(sqlite3* db, const MovieConfig& c) {
-  if (!db) return false;
-  char* sql = sqlite3_mprintf(
-      "INSERT INTO movie_config(id, duration_sec, frame_rate, width, height) VALUES(1, %f, %f, %d, %d)"
-      " ON CONFLICT(id) DO UPDATE SET duration_sec=excluded.duration_sec, frame_rate=excluded.frame_rate,"
-      " width=excluded.width, height=excluded.height",
-      c.duration_sec, c.frame_rate, c.width, c.height);
-  bool ok = sql && run_sql(db, sql);
-  if (sql) sqlite3_free(sql);
-  return ok;
-}
-
-struct SceneRow {
-  int id;
-  int sort_order;
-  std::string name;
-};
-std::vector<SceneRow> list_scenes(sqlite3* db) {
-  std::vector<SceneRow> out;
-  if (!db) return out;
-  sqlite3_stmt* stmt = nullptr;
-  if (sqlite3_prepare_v2(db, "SELECT id, sort_order, COALESCE(name, 'Scene ' || id) FROM scenes ORDER BY sort_order, id", -1, &stmt, nullptr) != SQLITE_OK)
-    return out;
-  while (sqlite3_step(stmt) == SQLITE_ROW) {
-    SceneRow r;
-    r.id = sqlite3_column_int(stmt, 0);
-    r.sort_order = sqlite3_column_int(stmt, 1);
-    const char* n = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 2));
-    r.name = n ? n : "";
-    out.push_back(r);
-  }
-  sqlite3_finalize(stmt);
-  return out;
-}
-
-bool create_scene(sqlite3* db) {
-  if (!db) return false;
-  sqlite3_stmt* stmt = nullptr;
-  if (sqlite3_prepare_v2(db, "SELECT COALESCE(MAX(sort_order), 0) + 1 FROM scenes WHERE timeline_id = 1", -1, &stmt, nullptr) != SQLITE_OK)
-    return false;
-  int next_order = 1;
-  if (sqlite3_step(stmt) == SQLITE_ROW)
-    next_order = sqlite3_column_int(stmt, 0);
-  sqlite3_finalize(stmt);
-  char* sql = sqlite3_mprintf("INSERT INTO scenes(timeline_id, sort_order, name) VALUES(1, %d, 'Scene %d')", next_order, next_order);
-  bool ok = sql && run_sql(db, sql);
-  if (sql) sqlite3_free(sql);
-  return ok;
-}
-
-bool rename_scene(sqlite3* db, int id, const std::string& name) {
-  if (!db || name.empty()) return false;
-  char* sql = sqlite3_mprintf("UPDATE scenes SET name = '%q' WHERE id = %d", name.c_str(), id);
-  bool ok = sql && run_sql(db, sql);
-  if (sql) sqlite3_free(sql);
-  return ok;
-}
-
-bool delete_scene(sqlite3* db, int id) {
-  if (!db) return false;
-  char* sql = sqlite3_mprintf("DELETE FROM layers WHERE scene_id = %d; DELETE FROM scenes WHERE id = %d", id, id);
-  bool ok = sql && run_sql(db, sql);
-  if (sql) sqlite3_free(sql);
-  return ok;
-}
-
-bool move_scene_up(sqlite3* db, int scene_id) {
-  if (!db) return false;
-  sqlite3_stmt* stmt = nullptr;
-  if (sqlite3_prepare_v2(db, "SELECT sort_order FROM scenes WHERE id = ?", -1, &stmt, nullptr) != SQLITE_OK)
-    return false;
-  sqlite3_bind_int(stmt, 1, scene_id);
-  if (sqlite3_step(stmt) != SQLITE_ROW) { sqlite3_finalize(stmt); return false; }
-  int order = sqlite3_column_int(stmt, 0);
-  sqlite3_finalize(stmt);
-  stmt = nullptr;
-  if (sqlite3_prepare_v2(db, "SELECT id FROM scenes WHERE sort_order < ? ORDER BY sort_order DESC LIMIT 1", -1, &stmt, nullptr) != SQLITE_OK)
-    return false;
-  sqlite3_bind_int(stmt, 1, order);
-  if (sqlite3_step(stmt) != SQLITE_ROW) { sqlite3_finalize(stmt); return false; }
-  int other_id = sqlite3_column_int(stmt, 0);
-  sqlite3_finalize(stmt);
-  char* sql = sqlite3_mprintf("UPDATE scenes SET sort_order = CASE id WHEN %d THEN %d WHEN %d THEN %d END WHERE id IN (%d, %d)",
-      scene_id, order - 1, other_id, order, scene_id, other_id);
-  bool ok = sql && run_sql(db, sql);
-  if (sql) sqlite3_free(sql);
-  return ok;
-}
-
-bool move_scene_down(sqlite3* db, int scene_id) {
-  if (!db) return false;
-  sqlite3_stmt* stmt = nullptr;
-  if (sqlite3_prepare_v2(db, "SELECT sort_order FROM scenes WHERE id = ?", -1, &stmt, nullptr) != SQLITE_OK)
-    return false;
-  sqlite3_bind_int(stmt, 1, scene_id);
-  if (sqlite3_step(stmt) != SQLITE_ROW) { sqlite3_finalize(stmt); return false; }
-  int order = sqlite3_column_int(stmt, 0);
-  sqlite3_finalize(stmt);
-  stmt = nullptr;
-  if (sqlite3_prepare_v2(db, "SELECT id FROM scenes WHERE sort_order > ? ORDER BY sort_order ASC LIMIT 1", -1, &stmt, nullptr) != SQLITE_OK)
-    return false;
-  sqlite3_bind_int(stmt, 1, order);
-  if (sqlite3_step(stmt) != SQLITE_ROW) { sqlite3_finalize(stmt); return false; }
-  int other_id = sqlite3_column_int(stmt, 0);
-  sqlite3_finalize(stmt);
-  char* sql = sqlite3_mprintf("UPDATE scenes SET sort_order = CASE id WHEN %d THEN %d WHEN %d THEN %d END WHERE id IN (%d, %d)",
-      scene_id, order + 1, other_id, order, scene_id, other_id);
-  bool ok = sql && run_sql(db, sql);
-  if (sql) sqlite3_free(sql);
-  return ok;
+// Export scales on the CPU unless CHYA_EXPORT_GPU=1, like `--render` without `--gpu`: GPU frames differ
+// slightly, and the render cache keeps the chunks of one backend only.
+bool export_uses_gpu() {
+  const char* v = std::getenv("CHYA_EXPORT_GPU");
+  return v && std::strcmp(v, "1") == 0;
 }
 
-struct LayerRow {
-  int id;
-  std::string image_path;
-  int start_frame;
-  int frame_span;
-};
-std::vector<LayerRow> list_layers(sqlite3* db, int scene_id) {
-  std::vector<LayerRow> out;
-  if (!db) return out;
-  sqlite3_stmt* stmt = nullptr;
-  if (sqlite3_prepare_v2(db, "SELECT id, image_path, sort_order, COALESCE(frame_span, 1) FROM layers WHERE scene_id = ? ORDER BY sort_order, id", -1, &stmt, nullptr) != SQLITE_OK)
-    return out;
-  sqlite3_bind_int(stmt, 1, scene_id);
-  while (sqlite3_step(stmt) == SQLITE_ROW) {
-    LayerRow r;
-    r.id = sqlite3_column_int(stmt, 0);
-    const char* p = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 1));
-    r.image_path = p ? p : "";
-    r.start_frame = sqlite3_column_int(stmt, 2);
-    r.frame_span = sqlite3_column_int(stmt, 3);
-    if (r.frame_span < 1) r.frame_span = 1;
-    out.push_back(r);
+static void render_worker(std::string project_root, std::string output_path, std::atomic<float>* progress, std::atomic<int>* done, std::string* error, FrameScaler* scaler) {
+  sqlite3* db = nullptr;
+  if (sqlite3_open((project_root + "/project.db").c_str(), &db) != SQLITE_OK) {
+    if (error) *error = "Could not open project.db";
+    sqlite3_close(db);
+    if (done) done->store(-1);
+    return;
   }
-  sqlite3_finalize(stmt);
-  return out;
-}
-
-bool add_layer_at_frame(sqlite3* db, int scene_id, int frame_index, const std::string& image_path, int frame_span = 1) {
-  if (!db || frame_index < 0 || frame_span < 1) return false;
-  char* ins_sql = sqlite3_mprintf("INSERT INTO layers(scene_id, image_path, sort_order, frame_span) VALUES(%d, '%q', %d, %d)", scene_id, image_path.c_str(), frame_index, frame_span);
-  bool ok = ins_sql && run_sql(db, ins_sql);
-  if (ins_sql) sqlite3_free(ins_sql);
-  return ok;
-}
-
-bool update_layer_start_frame(sqlite3* db, int layer_id, int start_frame) {
-  if (!db || start_frame < 0) return false;
-  char* sql = sqlite3_mprintf("UPDATE layers SET sort_order = %d WHERE id = %d", start_frame, layer_id);
-  bool ok = sql && run_sql(db, sql);
-  if (sql) sqlite3_free(sql);
-  return ok;
-}
-
-bool update_layer_span(sqlite3* db, int layer_id, int frame_span) {
-  if (!db || frame_span < 1) return false;
-  char* sql = sqlite3_mprintf("UPDATE layers SET frame_span = %d WHERE id = %d", frame_span, layer_id);
-  bool ok = sql && run_sql(db, sql);
-  if (sql) sqlite3_free(sql);
-  return ok;
+  configure_connection(db);
+  bool ok = render_project_to_video(db, project_root, output_path, progress, error, nullptr, scaler);
+  close_db(db);
+  if (done) done->store(ok ? 1 : -1);
+  if (progress) progress->store(1.f);
 }
 
-bool delete_layer(sqlite3* db, int layer_id) {
-  if (!db) return false;
-  char* sql = sqlite3_mprintf("DELETE FROM layers WHERE id = %d", layer_id);
-  bool ok = sql && run_sql(db, sql);
-  if (sql) sqlite3_free(sql);
-  return ok;
+void start_playback(int start_frame) {
+  const SceneFrameIndex& scene = g_project.model.frame_index(g_play_scene_id);
+  g_play_scene_revision = scene.revision;
+  g_play_config = g_project.model.config();
+  g_playback.start(g_play_window, g_project.path, scene, g_project.model.media_index(), g_play_config, start_frame);
 }
 
-std::string get_image_at_frame(sqlite3* db, int scene_id, int frame) {
-  std::vector<LayerRow> layers = list_layers(db, scene_id);
-  std::string path;
-  for (const LayerRow& L : layers)
-    if (frame >= L.start_frame && frame < L.start_frame + L.frame_span)
-      path = L.image_path;
-  return path;
+void close_play_window() {
+  if (!g_play_window) return;
+  g_playback.stop();
+  glfwDestroyWindow(g_play_window);
+  g_play_window = nullptr;
 }
 
-int get_scene_used_frame_count(sqlite3* db, int scene_id) {
-  std::vector<LayerRow> layers = list_layers(db, scene_id);
-  int end_frame = 0;
-  for (const LayerRow& L : layers) {
-    int layer_end = L.start_frame + L.frame_span;
-    if (layer_end > end_frame) end_frame = layer_end;
+static void media_check_worker(std::string project_root) {
+  sqlite3* db = nullptr;
+  int updated = -1;
+  if (sqlite3_open((project_root + "/project.db").c_str(), &db) == SQLITE_OK) {
+    configure_connection(db);
+    updated = revalidate_media(db, project_root, &g_media_check_cancel);
+    close_db(db);
+  } else {
+    sqlite3_close(db);
   }
-  return end_frame;
+  g_media_check_updated.store(updated);
+  g_media_check_done.store(true);
 }
 
-static void scale_rgba_to(const unsigned char* src, int sw, int sh, unsigned char* dst, int dw, int dh) {
-  for (int y = 0; y < dh; y++) {
-    int sy = (dh > 1 && sh > 0) ? (y * (sh - 1) / (dh - 1)) : 0;
-    if (sy >= sh) sy = sh - 1;
-    for (int x = 0; x < dw; x++) {
-      int sx = (dw > 1 && sw > 0) ? (x * (sw - 1) / (dw - 1)) : 0;
-      if (sx >= sw) sx = sw - 1;
-      int si = (sy * sw + sx) * 4;
-      int di = (y * dw + x) * 4;
-      dst[di] = src[si];
-      dst[di + 1] = src[si + 1];
-      dst[di + 2] = src[si + 2];
-      dst[di + 3] = src[si + 3];
-    }
-  }
+void start_media_check(const std::string& project_root) {
+  g_media_check_cancel.store(false);
+  g_media_check_done.store(false);
+  g_media_check_thread = std::thread(media_check_worker, project_root);
 }
 
-bool render_project_to_video(sqlite3* db, const std::string& project_root, const std::string& output_path, std::atomic<float>* progress) {
-  if (!db || project_root.empty() || output_path.empty()) return false;
-  MovieConfig cfg = get_movie_config(db);
-  std::vector<SceneRow> scenes = list_scenes(db);
-  if (scenes.empty()) return false;
-  int total_frames = 0;
-  std::vector<int> scene_frame_counts;
-  scene_frame_counts.reserve(scenes.size());
-  for (const SceneRow& scene : scenes) {
-    int n = get_scene_used_frame_count(db, scene.id);
-    scene_frame_counts.push_back(n);
-    total_frames += n;
-  }
-  if (total_frames <= 0) return false;
-  const int out_w = cfg.width;
-  const int out_h = cfg.height;
-  fs::path tmp_dir = fs::path(project_root) / ".render_frames";
-  std::error_code ec;
-  fs::create_directories(tmp_dir, ec);
-  if (ec) return false;
-  std::vector<std::string> written;
-  int frame_idx = 0;
-  std::vector<unsigned char> out_buf(static_cast<size_t>(out_w) * out_h * 4, 0);
-  for (size_t s = 0; s < scenes.size(); s++) {
-    const SceneRow& scene = scenes[s];
-    const int frames_this_scene = scene_frame_counts[s];
-    for (int f = 0; f < frames_this_scene; f++) {
-      if (progress) progress->store(static_cast<float>(frame_idx) / static_cast<float>(total_frames));
-      std::string rel = get_image_at_frame(db, scene.id, f);
-      if (!rel.empty()) {
-        std::string full = (fs::path(project_root) / rel).string();
-        int iw = 0, ih = 0, ic = 0;
-        unsigned char* img = stbi_load(full.c_str(), &iw, &ih, &ic, 4);
-        if (img && iw > 0 && ih > 0) {
-          scale_rgba_to(img, iw, ih, out_buf.data(), out_w, out_h);
-          stbi_image_free(img);
-        } else {
-          std::fill(out_buf.begin(), out_buf.end(), 0);
-        }
-      } else {
-        std::fill(out_buf.begin(), out_buf.end(), 0);
-      }
-      char fn[256];
-      snprintf(fn, sizeof(fn), "frame_%05d.png", frame_idx);
-      std::string path = (tmp_dir / fn).string();
-      if (!stbi_write_png(path.c_str(), out_w, out_h, 4, out_buf.data(), 0))
-        break;
-      written.push_back(path);
-      frame_idx++;
-    }
-  }
-  if (progress) progress->store(1.f);
-  if (written.size() != static_cast<size_t>(frame_idx)) {
-    for (const auto& p : written) fs::remove(p, ec);
-    fs::remove(tmp_dir, ec);
-    return false;
-  }
-  std::string ff_cmd = "ffmpeg -y -framerate " + std::to_string(static_cast<int>(cfg.frame_rate)) +
-      " -i \"" + tmp_dir.string() + "/frame_%05d.png\" -c:v libx264 -pix_fmt yuv420p \"" + output_path + "\" 2>/dev/null";
-  int ret = std::system(ff_cmd.c_str());
-  for (const auto& p : written) fs::remove(p, ec);
-  fs::remove(tmp_dir, ec);
-  return (ret == 0);
+// Picks up the check's result once it is done; with cancel, stops it and waits.
+void finish_media_check(bool cancel) {
+  if (!g_media_check_thread.joinable()) return;
+  if (cancel)
+    g_media_check_cancel.store(true);
+  else if (!g_media_check_done.load())
+    return;
+  g_media_check_thread.join();
+  if (g_media_check_updated.load() > 0 && g_project.db)
+    g_project.model.reload_media();
 }
 
-static void render_worker(std::string project_root, std::string output_path, std::atomic<float>* progress, std::atomic<int>* done) {
-  sqlite3* db = nullptr;
-  if (sqlite3_open((project_root + "/project.db").c_str(), &db) != SQLITE_OK) {
-    if (done) done->store(-1);
-    return;
+// Records a finished import batch in the open project with one transaction.
+void record_imported_media() {
+  std::vector<ImportedMedia> imported;
+  int failed = 0;
+  if (!g_media_import.take_finished(&imported, &failed)) return;
+  std::vector<MediaRow> rows;
+  rows.reserve(imported.size());
+  for (ImportedMedia& m : imported) rows.push_back(std::move(m.media));
+  int duplicates = 0;
+  if (g_project.db) {
+    const int added = g_project.model.add_media_rows(rows);
+    if (added < 0)
+      failed += static_cast<int>(rows.size());
+    else
+      duplicates = static_cast<int>(rows.size()) - added;
   }
-  bool ok = render_project_to_video(db, project_root, output_path, progress);
-  sqlite3_close(db);
-  if (done) done->store(ok ? 1 : -1);
-  if (progress) progress->store(1.f);
+  g_media_import_failed = failed;
+  g_media_import_duplicates = duplicates;
 }
 
 void close_project() {
-  if (g_play_window) {
-    glfwDestroyWindow(g_play_window);
-    g_play_window = nullptr;
-  }
+  finish_media_check(true);
+  g_media_import.cancel();
+  record_imported_media();
+  close_play_window();
   clear_thumbnail_cache();
+  g_project.model.reset();
   g_project.db.reset();
   g_project.path.clear();
   g_project.name.clear();
@@ -459,8 +210,10 @@ bool open_project_db(const std::string& project_root, const std::string& project
     return false;
   }
   g_project.db.reset(raw);
+  g_project.model.load(raw);
   g_project.path = project_root;
   g_project.name = project_name;
+  start_media_check(project_root);
   push_recent_project(project_root);
   return true;
 }
@@ -493,16 +246,12 @@ bool create_project(const std::string& name) {
     sqlite3_close(raw);
     return false;
   }
-  char* insert_sql = sqlite3_mprintf(
-      "INSERT INTO projects(name, path) VALUES('%q', '%q')",
-      safe_name.c_str(), project_root.string().c_str());
-  bool ok = insert_sql && run_sql(raw, insert_sql);
-  if (insert_sql) sqlite3_free(insert_sql);
-  if (!ok) {
-    sqlite3_close(raw);
+  if (!record_project(raw, safe_name, project_root.string())) {
+    close_db(raw);
     return false;
   }
   g_project.db.reset(raw);
+  g_project.model.load(raw);
   g_project.path = project_root.string();
   g_project.name = safe_name;
   push_recent_project(g_project.path);
@@ -551,117 +300,11 @@ std::vector<std::string> list_project_folders() {
   return out;
 }
 
-bool is_image_extension(const std::string& path) {
-  std::string ext = fs::path(path).extension().string();
-  std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
-  return ext == ".png" || ext == ".jpg" || ext == ".jpeg" || ext == ".gif" ||
-         ext == ".bmp" || ext == ".webp" || ext == ".tga";
-}
-
-bool add_media_file(sqlite3* db, const std::string& project_root, const std::string& source_path) {
-  if (!db || project_root.empty() || !fs::is_regular_file(source_path))
-    return false;
-  fs::path dest_dir = fs::path(project_root) / "media";
-  std::string stem = fs::path(source_path).stem().string();
-  std::string ext = fs::path(source_path).extension().string();
-  fs::path dest = dest_dir / (stem + ext);
-  int n = 0;
-  while (fs::exists(dest))
-    dest = dest_dir / (stem + "_" + std::to_string(++n) + ext);
-  std::error_code ec;
-  fs::copy(fs::path(source_path), dest, fs::copy_options::overwrite_existing, ec);
-  if (ec) return false;
-  std::string rel = "media/" + dest.filename().string();
-  char* sql = sqlite3_mprintf("INSERT INTO media(path) VALUES('%q')", rel.c_str());
-  bool ok = sql && run_sql(db, sql);
-  if (sql) sqlite3_free(sql);
-  return ok;
-}
-
-std::vector<std::string> list_media(sqlite3* db) {
-  std::vector<std::string> out;
-  if (!db) return out;
-  sqlite3_stmt* stmt = nullptr;
-  if (sqlite3_prepare_v2(db, "SELECT path FROM media ORDER BY id", -1, &stmt, nullptr) != SQLITE_OK)
-    return out;
-  while (sqlite3_step(stmt) == SQLITE_ROW) {
-    const char* p = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0));
-    if (p) out.push_back(p);
-  }
-  sqlite3_finalize(stmt);
-  return out;
-}
-
-bool delete_media(sqlite3* db, const std::string& rel_path) {
-  if (!db || rel_path.empty()) return false;
-  char* sql = sqlite3_mprintf("DELETE FROM media WHERE path = '%q'", rel_path.c_str());
-  bool ok = sql && run_sql(db, sql);
-  if (sql) sqlite3_free(sql);
-  return ok;
-}
-
-bool rename_media(sqlite3* db, const std::string& project_root, const std::string& old_rel_path, const std::string& new_filename) {
-  if (!db || project_root.empty() || old_rel_path.empty() || new_filename.empty())
-    return false;
-  if (old_rel_path.find("media/") != 0) return false;
-  std::string new_rel = "media/" + new_filename;
-  if (new_rel == old_rel_path) return true;
-  fs::path old_full = fs::path(project_root) / old_rel_path;
-  fs::path new_full = fs::path(project_root) / new_rel;
-  if (!fs::is_regular_file(old_full)) return false;
-  if (fs::exists(new_full)) return false;
-  std::error_code ec;
-  fs::rename(old_full, new_full, ec);
-  if (ec) return false;
-  char* sql_media = sqlite3_mprintf("UPDATE media SET path = '%q' WHERE path = '%q'", new_rel.c_str(), old_rel_path.c_str());
-  bool ok = sql_media && run_sql(db, sql_media);
-  if (sql_media) sqlite3_free(sql_media);
-  if (!ok) return false;
-  char* sql_layers = sqlite3_mprintf("UPDATE layers SET image_path = '%q' WHERE image_path = '%q'", new_rel.c_str(), old_rel_path.c_str());
-  ok = sql_layers && run_sql(db, sql_layers);
-  if (sql_layers) sqlite3_free(sql_layers);
-  return ok;
-}
-
 std::vector<std::string> g_dropped_paths;
 
 constexpr int kThumbSize = 80;
-struct ThumbEntry { GLuint tex = 0; int w = 0; int h = 0; };
-std::map<std::string, ThumbEntry> g_thumb_cache;
-
-void clear_thumbnail_cache() {
-  for (auto& p : g_thumb_cache) {
-    if (p.second.tex != 0)
-      glDeleteTextures(1, &p.second.tex);
-  }
-  g_thumb_cache.clear();
-}
-
-ImTextureID get_thumbnail_texture(const std::string& project_root, const std::string& rel_path, int* out_w = nullptr, int* out_h = nullptr) {
-  std::string key = project_root + "/" + rel_path;
-  auto it = g_thumb_cache.find(key);
-  if (it != g_thumb_cache.end()) {
-    if (out_w) *out_w = it->second.w;
-    if (out_h) *out_h = it->second.h;
-    return (ImTextureID)(intptr_t)it->second.tex;
-  }
-  std::string full = (fs::path(project_root) / rel_path).string();
-  int w = 0, h = 0, comp = 0;
-  unsigned char* data = stbi_load(full.c_str(), &w, &h, &comp, 4);
-  if (!data || w <= 0 || h <= 0) return nullptr;
-  GLuint tex = 0;
-  glGenTextures(1, &tex);
-  glBindTexture(GL_TEXTURE_2D, tex);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, w, h, 0, GL_RGBA, GL_UNSIGNED_BYTE, data);
-  stbi_image_free(data);
-  glBindTexture(GL_TEXTURE_2D, 0);
-  g_thumb_cache[key] = ThumbEntry{tex, w, h};
-  if (out_w) *out_w = w;
-  if (out_h) *out_h = h;
-  return (ImTextureID)(intptr_t)tex;
-}
+// Media rows above and below the visible ones whose thumbnails are requested ahead of scrolling.
+constexpr int kMediaPrefetchRows = 2;
 
 void drop_callback(GLFWwindow*, int count, const char** paths) {
   for (int i = 0; i < count; i++)
@@ -675,61 +318,6 @@ constexpr float kClearColorG = 0.12f;
 constexpr float kClearColorB = 0.14f;
 constexpr float kClearColorA = 1.f;
 
-#ifndef GL_STATIC_DRAW
-#define GL_STATIC_DRAW 0x88E4
-#endif
-typedef void (*PFNGLDRAWARRAYSPROC)(unsigned int mode, int first, int count);
-
-static const char* kQuadVs = "#version 330\n"
-  "layout(location=0) in vec2 pos;\n"
-  "out vec2 uv;\n"
-  "void main() { gl_Position = vec4(pos, 0, 1); uv = pos*0.5+0.5; }\n";
-static const char* kQuadFs = "#version 330\n"
-  "in vec2 uv; uniform sampler2D tex; out vec4 fragColor;\n"
-  "void main() { fragColor = texture(tex, vec2(uv.x, 1.0 - uv.y)); }\n";
-
-GLuint create_quad_program() {
-  GLuint vs = glCreateShader(GL_VERTEX_SHADER);
-  glShaderSource(vs, 1, &kQuadVs, nullptr);
-  glCompileShader(vs);
-  GLuint fs = glCreateShader(GL_FRAGMENT_SHADER);
-  glShaderSource(fs, 1, &kQuadFs, nullptr);
-  glCompileShader(fs);
-  GLuint prog = glCreateProgram();
-  glAttachShader(prog, vs);
-  glAttachShader(prog, fs);
-  glLinkProgram(prog);
-  glDeleteShader(vs);
-  glDeleteShader(fs);
-  return prog;
-}
-
-void draw_textured_quad(GLuint program, GLuint texture_id) {
-  static GLuint vao = 0, vbo = 0;
-  static PFNGLDRAWARRAYSPROC fn_draw_arrays = nullptr;
-  if (vao == 0) {
-    float verts[] = {-1,-1, 1,-1, -1,1,  -1,1, 1,-1, 1,1};
-    glGenVertexArrays(1, &vao);
-    glGenBuffers(1, &vbo);
-    glBindVertexArray(vao);
-    glBindBuffer(GL_ARRAY_BUFFER, vbo);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(verts), verts, GL_STATIC_DRAW);
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 0, nullptr);
-    glBindVertexArray(0);
-  }
-  if (fn_draw_arrays == nullptr && g_play_window)
-    fn_draw_arrays = (PFNGLDRAWARRAYSPROC)glfwGetProcAddress("glDrawArrays");
-  if (fn_draw_arrays == nullptr) return;
-  glUseProgram(program);
-  glActiveTexture(GL_TEXTURE0);
-  glBindTexture(GL_TEXTURE_2D, texture_id);
-  glUniform1i(glGetUniformLocation(program, "tex"), 0);
-  glBindVertexArray(vao);
-  fn_draw_arrays(GL_TRIANGLES, 0, 6);
-  glBindVertexArray(0);
-}
-
 void set_glfw_window_hints() {
   glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
   glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
@@ -945,11 +533,18 @@ void draw_ui() {
     return;
   }
 
+  std::vector<std::string> to_import;
   for (const std::string& p : g_dropped_paths) {
     if (is_image_extension(p))
-      add_media_file(g_project.db.get(), g_project.path, p);
+      to_import.push_back(p);
   }
   g_dropped_paths.clear();
+  finish_media_check(false);
+  if (!to_import.empty() && g_media_import.add(g_project.path, to_import)) {
+    g_media_import_failed = 0;
+    g_media_import_duplicates = 0;
+  }
+  record_imported_media();
 
   ImGuiViewport* vp = ImGui::GetMainViewport();
   ImGui::SetNextWindowPos(vp->WorkPos);
@@ -966,13 +561,15 @@ void draw_ui() {
   static int s_selected_scene_id = 0;
   static int s_selected_layer_id = 0;
   static int s_selected_layer_scene_id = 0;
-  static std::string s_selected_media_path;
+  static int s_selected_media_id = 0;
   static int s_pixels_per_frame = 8;
-  static std::string s_clipboard_path;
+  static int s_clipboard_media_id = 0;
   static int s_clipboard_frame_span = 1;
   static std::atomic<float> s_render_progress(-1.f);
   static std::atomic<int> s_render_done(0);
+  static std::string s_render_error;
   static std::unique_ptr<std::thread> s_render_thread;
+  static std::unique_ptr<FrameScaler> s_render_scaler;  // owns a hidden window, so created and destroyed here
   static ImVec2 s_render_btn_min(0, 0), s_render_btn_max(0, 0);
   static bool s_render_btn_rect_valid = false;
 
@@ -997,6 +594,7 @@ void draw_ui() {
       if (s_render_thread && s_render_thread->joinable())
         s_render_thread->join();
       s_render_thread.reset();
+      s_render_scaler.reset();
       if (s_render_done.load() == 1)
         ImGui::OpenPopup("##render_ok");
       else
@@ -1019,12 +617,15 @@ void draw_ui() {
     if (rendering)
       ImGui::BeginDisabled();
     if (ImGui::Button(rendering ? ICON_FA_FILM " Render..." : ICON_FA_FILM " Render", ImVec2(render_btn_w, 0))) {
-      if (!rendering && g_project.db && !g_project.path.empty() && !list_scenes(g_project.db.get()).empty()) {
+      if (!rendering && g_project.db && !g_project.path.empty() && !g_project.model.scenes().empty()) {
         static char save_path[4096] = "";
         if (pick_save_file(save_path, sizeof(save_path), "output.mp4")) {
           s_render_progress.store(0.f);
           s_render_done.store(0);
-          s_render_thread = std::make_unique<std::thread>(render_worker, g_project.path, std::string(save_path), &s_render_progress, &s_render_done);
+          s_render_error.clear();
+          if (export_uses_gpu())
+            s_render_scaler = create_gpu_frame_scaler();
+          s_render_thread = std::make_unique<std::thread>(render_worker, g_project.path, std::string(save_path), &s_render_progress, &s_render_done, &s_render_error, s_render_scaler.get());
         }
       }
     }
@@ -1038,7 +639,7 @@ void draw_ui() {
       s_render_btn_rect_valid = false;
     }
     if (ImGui::IsItemHovered())
-      ImGui::SetTooltip(rendering ? "Rendering..." : "Render all scenes to video (requires ffmpeg)");
+      ImGui::SetTooltip(rendering ? "Rendering..." : "Render all scenes to video (requires ffmpeg in PATH)");
     ImGui::SameLine();
     if (ImGui::Button(ICON_FA_PLAY " Play", ImVec2(play_btn_w, 0))) {
       if (g_play_window) {
@@ -1047,8 +648,8 @@ void draw_ui() {
         set_glfw_window_hints();
         g_play_window = glfwCreateWindow(640, 360, "Timeline playback", nullptr, g_main_window);
         if (g_play_window) {
-          g_play_start_time = glfwGetTime();
           g_play_scene_id = s_selected_scene_id;
+          start_playback(0);
         }
       }
     }
@@ -1062,7 +663,7 @@ void draw_ui() {
     }
     ImGui::SetNextWindowPos(ImGui::GetMainViewport()->GetCenter(), ImGuiCond_Appearing, ImVec2(0.5f, 0.5f));
     if (ImGui::BeginPopupModal("##render_fail", nullptr, ImGuiWindowFlags_AlwaysAutoResize)) {
-      ImGui::Text("Render failed. Is ffmpeg installed?");
+      ImGui::Text("Render failed: %s", s_render_error.empty() ? "unknown error" : s_render_error.c_str());
       if (ImGui::Button(ICON_FA_CHECK " OK")) ImGui::CloseCurrentPopup();
       ImGui::EndPopup();
     }
@@ -1070,17 +671,13 @@ void draw_ui() {
 
     if (!ImGui::IsAnyItemActive() && (ImGui::IsKeyPressed(ImGuiKey_Delete) || ImGui::IsKeyPressed(ImGuiKey_Backspace))) {
       if (s_selected_layer_id != 0) {
-        delete_layer(g_project.db.get(), s_selected_layer_id);
+        g_project.model.delete_layer(s_selected_layer_id);
         s_selected_layer_id = 0;
-      } else if (!s_selected_media_path.empty()) {
-        if (delete_media(g_project.db.get(), s_selected_media_path)) {
-          std::string key = g_project.path + "/" + s_selected_media_path;
-          auto it = g_thumb_cache.find(key);
-          if (it != g_thumb_cache.end()) {
-            if (it->second.tex != 0) glDeleteTextures(1, &it->second.tex);
-            g_thumb_cache.erase(it);
-          }
-          s_selected_media_path.clear();
+      } else if (s_selected_media_id != 0) {
+        if (g_project.model.delete_media(s_selected_media_id)) {
+          if (!g_project.model.find_media(s_selected_media_id))
+            forget_thumbnail(s_selected_media_id);
+          s_selected_media_id = 0;
         }
       }
     }
@@ -1104,7 +701,7 @@ void draw_ui() {
     if (ImGui::BeginChild("##config_panel", ImVec2(config_w, -1), true, ImGuiWindowFlags_None)) {
       ImGui::Text("Configuration");
       ImGui::Spacing();
-      MovieConfig cfg = get_movie_config(g_project.db.get());
+      MovieConfig cfg = g_project.model.config();
       bool changed = false;
       ImGui::Text("Duration (sec)");
       ImGui::SetNextItemWidth(-1);
@@ -1128,62 +725,123 @@ void draw_ui() {
         changed = true;
       if (cfg.height < 1) cfg.height = 1;
       if (cfg.height > 4320) cfg.height = 4320;
+      ImGui::Text("Scaling");
+      ImGui::SetNextItemWidth(-1);
+      static const char* kScaleModeNames[] = {"Fit (letterbox)", "Fill (crop)", "Stretch"};
+      int scale_mode = static_cast<int>(cfg.scale_mode);
+      if (ImGui::Combo("##scale_mode", &scale_mode, kScaleModeNames, IM_ARRAYSIZE(kScaleModeNames))) {
+        cfg.scale_mode = static_cast<ScaleMode>(scale_mode);
+        changed = true;
+      }
       if (changed)
-        set_movie_config(g_project.db.get(), cfg);
+        g_project.model.set_config(cfg);
     }
     ImGui::EndChild();
 
     ImGui::SameLine();
     if (ImGui::BeginChild("##media_panel", ImVec2(media_w, -1), true, ImGuiWindowFlags_None)) {
       ImGui::Text("Media");
+      ThumbnailStats ts = get_thumbnail_stats();
+      ImGui::SameLine();
+      ImGui::TextDisabled("(%d cached, %.0f / %.0f MB)", ts.resident_count, ts.resident_bytes / 1048576.0, ts.budget_bytes / 1048576.0);
+      if (ImGui::IsItemHovered()) {
+        const uint64_t lookups = ts.hits + ts.misses;
+        ImGui::SetTooltip("Thumbnail cache: %.1f%% hit rate, %llu evictions, %d loading",
+                          lookups > 0 ? 100.0 * ts.hits / lookups : 0.0, (unsigned long long)ts.evictions, ts.pending_count);
+      }
       ImGui::Text("Drop images onto the window to add to project.");
-      if (!s_selected_media_path.empty()) {
+      const MediaImportProgress import_progress = g_media_import.progress();
+      if (import_progress.total > 0) {
+        char overlay[64];
+        snprintf(overlay, sizeof(overlay), "Importing %d / %d", import_progress.done, import_progress.total);
+        ImGui::ProgressBar(static_cast<float>(import_progress.done) / import_progress.total, ImVec2(-1.f, 0.f), overlay);
+      } else {
+        if (g_media_import_duplicates > 0)
+          ImGui::TextDisabled("%d file(s) were already in the project.", g_media_import_duplicates);
+        if (g_media_import_failed > 0)
+          ImGui::TextDisabled("%d file(s) could not be imported.", g_media_import_failed);
+      }
+      if (s_selected_media_id != 0) {
         ImGui::SameLine();
         if (ImGui::Button(ICON_FA_PEN " Rename")) {
-          std::string fname = fs::path(s_selected_media_path).filename().string();
+          const MediaRow* selected = g_project.model.find_media(s_selected_media_id);
+          std::string fname = selected ? selected->name : std::string();
           strncpy(s_rename_media_buf, fname.c_str(), sizeof(s_rename_media_buf) - 1);
           s_rename_media_buf[sizeof(s_rename_media_buf) - 1] = '\0';
           s_open_rename_media_popup = true;
         }
         if (ImGui::IsItemHovered())
-          ImGui::SetTooltip("Rename selected media file");
+          ImGui::SetTooltip("Rename selected media");
       }
       ImGui::Spacing();
-      std::vector<std::string> media = list_media(g_project.db.get());
+      const std::vector<MediaRow>& media = g_project.model.media();
       const float thumb_sz = static_cast<float>(kThumbSize);
       const float spacing = ImGui::GetStyle().ItemSpacing.x;
-      const int cols = (thumb_sz + spacing > 0) ? std::max(1, static_cast<int>(ImGui::GetContentRegionAvail().x / (thumb_sz + spacing))) : 1;
-      int col = 0;
-      for (const std::string& rel : media) {
-        ImGui::PushID(rel.c_str());
-        ImTextureID tex = get_thumbnail_texture(g_project.path, rel);
-        if (tex) {
-          ImGui::Image(tex, ImVec2(thumb_sz, thumb_sz));
-          if (ImGui::BeginDragDropSource(ImGuiDragDropFlags_SourceAllowNullID)) {
-            ImGui::SetDragDropPayload("CHYA_MEDIA", rel.c_str(), rel.size() + 1);
-            ImGui::Text("%s", rel.c_str());
-            ImGui::EndDragDropSource();
+      // Grid shape, recomputed only when the panel width or the library size changes.
+      struct MediaGridLayout {
+        float avail_w = -1.f;
+        size_t count = 0;
+        int cols = 1;
+        int rows = 0;
+      };
+      static MediaGridLayout s_media_grid;
+      const float avail_w = ImGui::GetContentRegionAvail().x;
+      if (s_media_grid.avail_w != avail_w || s_media_grid.count != media.size()) {
+        s_media_grid.avail_w = avail_w;
+        s_media_grid.count = media.size();
+        s_media_grid.cols = std::max(1, static_cast<int>(avail_w / (thumb_sz + spacing)));
+        s_media_grid.rows = static_cast<int>((media.size() + s_media_grid.cols - 1) / s_media_grid.cols);
+      }
+      const int cols = s_media_grid.cols;
+      // Only rows in view are laid out; thumbnails are requested for them plus a margin on either side.
+      ImGuiListClipper clipper;
+      clipper.Begin(s_media_grid.rows, thumb_sz + ImGui::GetStyle().ItemSpacing.y);
+      int first_row = s_media_grid.rows, end_row = 0;
+      while (clipper.Step()) {
+        first_row = std::min(first_row, clipper.DisplayStart);
+        end_row = std::max(end_row, clipper.DisplayEnd);
+        for (int row = clipper.DisplayStart; row < clipper.DisplayEnd; row++) {
+          const size_t row_end = std::min(media.size(), static_cast<size_t>(row + 1) * cols);
+          for (size_t i = static_cast<size_t>(row) * cols; i < row_end; i++) {
+            const MediaRow& item = media[i];
+            ImGui::PushID(item.id);
+            ImTextureID tex = get_thumbnail_texture(g_project.path, item);
+            if (tex) {
+              ImGui::Image(tex, ImVec2(thumb_sz, thumb_sz));
+              if (ImGui::BeginDragDropSource(ImGuiDragDropFlags_SourceAllowNullID)) {
+                ImGui::SetDragDropPayload("CHYA_MEDIA", &item.id, sizeof(item.id));
+                ImGui::Text("%s", item.name.c_str());
+                ImGui::EndDragDropSource();
+              }
+            } else {
+              // Placeholder while the thumbnail decodes in the background
+              ImGui::Dummy(ImVec2(thumb_sz, thumb_sz));
+              ImGui::GetWindowDrawList()->AddRectFilled(ImGui::GetItemRectMin(), ImGui::GetItemRectMax(), IM_COL32(60, 60, 66, 255));
+            }
+            if (ImGui::IsItemClicked(0)) {
+              s_selected_media_id = item.id;
+              s_selected_layer_id = 0;
+            }
+            if (ImGui::IsItemHovered())
+              ImGui::SetTooltip("%s (drag to timeline, Delete to remove)", item.name.c_str());
+            if (s_selected_media_id == item.id) {
+              ImVec2 a = ImGui::GetItemRectMin();
+              ImVec2 b = ImGui::GetItemRectMax();
+              ImGui::GetWindowDrawList()->AddRect(a, b, IM_COL32(255, 255, 0, 255), 0.f, 0, 3.f);
+            }
+            ImGui::PopID();
+            if (i + 1 < row_end)
+              ImGui::SameLine();
           }
-        } else {
-          ImGui::Dummy(ImVec2(thumb_sz, thumb_sz));
-        }
-        if (ImGui::IsItemClicked(0)) {
-          s_selected_media_path = rel;
-          s_selected_layer_id = 0;
         }
-        if (ImGui::IsItemHovered())
-          ImGui::SetTooltip("%s (drag to timeline, Delete to remove)", rel.c_str());
-        if (s_selected_media_path == rel) {
-          ImVec2 a = ImGui::GetItemRectMin();
-          ImVec2 b = ImGui::GetItemRectMax();
-          ImGui::GetWindowDrawList()->AddRect(a, b, IM_COL32(255, 255, 0, 255), 0.f, 0, 3.f);
-        }
-        ImGui::PopID();
-        col++;
-        if (col < cols)
-          ImGui::SameLine();
-        else
-          col = 0;
+      }
+      clipper.End();
+      if (first_row < end_row) {
+        const size_t prefetch_begin = static_cast<size_t>(std::max(0, first_row - kMediaPrefetchRows)) * cols;
+        const size_t prefetch_end = std::min(media.size(), static_cast<size_t>(end_row + kMediaPrefetchRows) * cols);
+        for (size_t i = prefetch_begin; i < prefetch_end; i++)
+          if (i < static_cast<size_t>(first_row) * cols || i >= static_cast<size_t>(end_row) * cols)
+            get_thumbnail_texture(g_project.path, media[i]);
       }
     }
     ImGui::EndChild();
@@ -1192,9 +850,10 @@ void draw_ui() {
     if (ImGui::BeginChild("##scenes_panel", ImVec2(rest - media_w, -1), true, ImGuiWindowFlags_None)) {
       ImGui::Text("Scenes");
       if (ImGui::Button(ICON_FA_PLUS " New scene"))
-        create_scene(g_project.db.get());
+        g_project.model.create_scene();
       ImGui::Spacing();
-      std::vector<SceneRow> scenes_list = list_scenes(g_project.db.get());
+      // Copied: the row buttons below reorder and delete scenes mid-loop
+      std::vector<SceneRow> scenes_list = g_project.model.scenes();
       const float btn_sz = 22.f;
       const float spacing = ImGui::GetStyle().ItemSpacing.x;
       const float buttons_w = btn_sz * 4.f + spacing * 3.f;
@@ -1211,12 +870,12 @@ void draw_ui() {
           s_selected_scene_id = scene.id;
         ImGui::SameLine(ImGui::GetCursorPosX() + selectable_w + spacing);
         if (ImGui::Button(ICON_FA_ARROW_UP, ImVec2(btn_sz, 0)) && i > 0)
-          move_scene_up(g_project.db.get(), scene.id);
+          g_project.model.move_scene_up(scene.id);
         if (ImGui::IsItemHovered())
           ImGui::SetTooltip("Move up");
         ImGui::SameLine();
         if (ImGui::Button(ICON_FA_ARROW_DOWN, ImVec2(btn_sz, 0)) && i + 1 < scenes_list.size())
-          move_scene_down(g_project.db.get(), scene.id);
+          g_project.model.move_scene_down(scene.id);
         if (ImGui::IsItemHovered())
           ImGui::SetTooltip("Move down");
         ImGui::SameLine();
@@ -1231,7 +890,7 @@ void draw_ui() {
         ImGui::SameLine();
         if (ImGui::Button(ICON_FA_TRASH, ImVec2(btn_sz, 0))) {
           if (s_selected_scene_id == scene.id) s_selected_scene_id = 0;
-          delete_scene(g_project.db.get(), scene.id);
+          g_project.model.delete_scene(scene.id);
         }
         if (ImGui::IsItemHovered())
           ImGui::SetTooltip("Delete");
@@ -1247,7 +906,7 @@ void draw_ui() {
       ImGui::SetNextItemWidth(240);
       ImGui::InputText("##name", s_rename_buf, sizeof(s_rename_buf));
       if (ImGui::Button(ICON_FA_CHECK " OK", ImVec2(80, 0))) {
-        if (rename_scene(g_project.db.get(), s_rename_scene_id, s_rename_buf)) {
+        if (g_project.model.rename_scene(s_rename_scene_id, s_rename_buf)) {
           s_rename_scene_id = 0;
           ImGui::CloseCurrentPopup();
         }
@@ -1267,16 +926,8 @@ if (ImGui::Button(ICON_FA_TIMES " Cancel", ImVec2(80, 0))) {
       if (ImGui::Button(ICON_FA_CHECK " OK", ImVec2(80, 0))) {
         std::string new_name(s_rename_media_buf);
         while (!new_name.empty() && (new_name.back() == ' ' || new_name.back() == '\n')) new_name.pop_back();
-        if (!new_name.empty() && rename_media(g_project.db.get(), g_project.path, s_selected_media_path, new_name)) {
-          std::string old_key = g_project.path + "/" + s_selected_media_path;
-          auto it = g_thumb_cache.find(old_key);
-          if (it != g_thumb_cache.end()) {
-            if (it->second.tex != 0) glDeleteTextures(1, &it->second.tex);
-            g_thumb_cache.erase(it);
-          }
-          s_selected_media_path = "media/" + new_name;
+        if (!new_name.empty() && g_project.model.rename_media(s_selected_media_id, new_name))
           ImGui::CloseCurrentPopup();
-        }
       }
       ImGui::SameLine();
       if (ImGui::Button(ICON_FA_TIMES " Cancel", ImVec2(80, 0)))
@@ -1285,7 +936,7 @@ if (ImGui::Button(ICON_FA_TIMES " Cancel", ImVec2(80, 0))) {
     }
 
     if (s_selected_scene_id != 0) {
-      MovieConfig cfg = get_movie_config(g_project.db.get());
+      const MovieConfig& cfg = g_project.model.config();
       if (ImGui::BeginChild("##timeline", ImVec2(0, timeline_h), true, ImGuiWindowFlags_NoScrollbar)) {
         ImGui::Text("Timeline: %g s  |  %.0f fps", cfg.duration_sec, cfg.frame_rate);
         ImGui::SameLine();
@@ -1320,7 +971,15 @@ if (ImGui::Button(ICON_FA_TIMES " Cancel", ImVec2(80, 0))) {
           ImDrawList* dl = ImGui::GetWindowDrawList();
           ImVec2 p0 = ImGui::GetCursorScreenPos();
           const double dur = (cfg.duration_sec > 0) ? cfg.duration_sec : 1.0;
-          for (double t = 0; t <= cfg.duration_sec; t += 1.0) {
+          // Only seconds and clips inside the scrolled-to window are laid out and drawn.
+          const float view_x0 = ImGui::GetWindowPos().x;
+          const float view_x1 = view_x0 + ImGui::GetWindowWidth();
+          const int first_visible_frame = std::max(0, static_cast<int>(std::floor((view_x0 - p0.x) / ppf)));
+          const int end_visible_frame = static_cast<int>(std::ceil((view_x1 - p0.x) / ppf)) + 1;
+          const double fps = cfg.frame_rate > 0 ? cfg.frame_rate : 1.0;
+          const double first_tick = std::floor(first_visible_frame / fps);
+          const double last_tick = std::min(cfg.duration_sec, std::ceil(end_visible_frame / fps));
+          for (double t = first_tick; t <= last_tick; t += 1.0) {
             float x = p0.x + static_cast<float>(t / dur) * content_w;
             char buf[16];
             snprintf(buf, sizeof(buf), "%.0fs", t);
@@ -1341,34 +1000,36 @@ if (ImGui::Button(ICON_FA_TIMES " Cancel", ImVec2(80, 0))) {
           };
           if (ImGui::BeginDragDropTarget()) {
             if (const ImGuiPayload* payload = ImGui::AcceptDragDropPayload("CHYA_MEDIA")) {
-              const char* path = static_cast<const char*>(payload->Data);
-              if (path && path[0] && total_frames > 0) {
+              int media_id = 0;
+              if (payload->DataSize == sizeof(media_id))
+                std::memcpy(&media_id, payload->Data, sizeof(media_id));
+              if (media_id != 0 && total_frames > 0) {
                 int frame_index = frame_from_mouse();
                 if (frame_index >= total_frames) frame_index = total_frames - 1;
-                add_layer_at_frame(g_project.db.get(), s_selected_scene_id, frame_index, path);
+                g_project.model.add_layer_at_frame(s_selected_scene_id, frame_index, media_id);
               }
             }
             ImGui::EndDragDropTarget();
           }
           dl->AddRectFilled(p0_track, p1_track, IM_COL32(50, 50, 55, 255));
           dl->AddRect(p0_track, p1_track, IM_COL32(80, 80, 85, 255));
-          for (double t = 0; t <= cfg.duration_sec; t += 1.0) {
+          for (double t = first_tick; t <= last_tick; t += 1.0) {
             float x = p0_track.x + static_cast<float>(t / dur) * content_w;
             dl->AddLine(ImVec2(x, p0_track.y), ImVec2(x, p1_track.y), IM_COL32(90, 90, 95, 255));
           }
 
-          std::vector<LayerRow> layers = list_layers(g_project.db.get(), s_selected_scene_id);
+          const std::vector<LayerRow>& layers = g_project.model.layers(s_selected_scene_id);
           const float edge_hit_w = 6.f;
 
           if (!ImGui::IsAnyItemActive()) {
             if (s_selected_layer_id != 0 && ImGui::IsKeyPressed(ImGuiKey_C) && (ImGui::GetIO().KeyCtrl || ImGui::GetIO().KeySuper)) {
               for (const LayerRow& L : layers)
                 if (L.id == s_selected_layer_id) {
-                  s_clipboard_path = L.image_path;
+                  s_clipboard_media_id = L.media_id;
                   s_clipboard_frame_span = L.frame_span;
                   break;
                 }
-            } else if (ImGui::IsKeyPressed(ImGuiKey_V) && (ImGui::GetIO().KeyCtrl || ImGui::GetIO().KeySuper) && !s_clipboard_path.empty()) {
+            } else if (ImGui::IsKeyPressed(ImGuiKey_V) && (ImGui::GetIO().KeyCtrl || ImGui::GetIO().KeySuper) && s_clipboard_media_id != 0) {
               int paste_at = 0;
               for (const LayerRow& L : layers)
                 if (L.id == s_selected_layer_id) {
@@ -1376,11 +1037,37 @@ if (ImGui::Button(ICON_FA_TIMES " Cancel", ImVec2(80, 0))) {
                   break;
                 }
               if (paste_at < total_frames)
-                add_layer_at_frame(g_project.db.get(), s_selected_scene_id, paste_at, s_clipboard_path, s_clipboard_frame_span);
+                g_project.model.add_layer_at_frame(s_selected_scene_id, paste_at, s_clipboard_media_id, s_clipboard_frame_span);
             }
           }
 
-          for (const LayerRow& layer : layers) {
+          // Clips intersecting the visible frames, from the scene's segment index, plus the clip being dragged or
+          // resized (its release is handled below even when it started off screen).
+          const SceneFrameIndex& frame_index = g_project.model.frame_index(s_selected_scene_id);
+          static std::vector<int> s_visible_layers;
+          frame_index.layers_in_range(first_visible_frame, end_visible_frame, &s_visible_layers);
+          for (int active_id : {s_dragging_layer_id, s_resize_layer_id}) {
+            if (active_id == 0) continue;
+            for (size_t i = 0; i < frame_index.layers.size(); i++)
+              if (frame_index.layers[i].id == active_id && !std::binary_search(s_visible_layers.begin(), s_visible_layers.end(), static_cast<int>(i)))
+                s_visible_layers.insert(std::upper_bound(s_visible_layers.begin(), s_visible_layers.end(), static_cast<int>(i)), static_cast<int>(i));
+          }
+          // Clip labels by layer id, rebuilt only when the media name or span changes.
+          struct ClipLabel {
+            std::string name;
+            int span = 0;
+            std::string text;
+            ImVec2 size;
+          };
+          static std::unordered_map<int, ClipLabel> s_clip_labels;
+          static int s_clip_labels_scene_id = 0;
+          if (s_clip_labels_scene_id != s_selected_scene_id) {
+            s_clip_labels.clear();
+            s_clip_labels_scene_id = s_selected_scene_id;
+          }
+
+          for (int layer_index : s_visible_layers) {
+            const LayerRow& layer = frame_index.layers[layer_index];
             int draw_start = (s_dragging_layer_id == layer.id || s_resize_layer_id == layer.id) ? s_live_start : layer.start_frame;
             int draw_span = (s_resize_layer_id == layer.id) ? s_live_span : layer.frame_span;
             float x0 = p0_track.x + draw_start * ppf;
@@ -1397,6 +1084,7 @@ if (ImGui::Button(ICON_FA_TIMES " Cancel", ImVec2(80, 0))) {
             if (on_left_edge) ImGui::SetMouseCursor(ImGuiMouseCursor_ResizeEW);
             if (on_right_edge) ImGui::SetMouseCursor(ImGuiMouseCursor_ResizeEW);
 
+            // Drags and resizes only move s_live_start/s_live_span; the layer row is written once, on release.
             if (s_resize_layer_id == layer_id) {
               int frame = frame_from_mouse();
               if (s_resize_left) {
@@ -1406,18 +1094,17 @@ if (ImGui::Button(ICON_FA_TIMES " Cancel", ImVec2(80, 0))) {
                 if (new_span >= 1) {
                   s_live_start = new_start;
                   s_live_span = new_span;
-                  update_layer_start_frame(g_project.db.get(), layer_id, new_start);
-                  update_layer_span(g_project.db.get(), layer_id, new_span);
                 }
               } else {
                 int new_span = std::max(1, frame - layer.start_frame);
-                if (new_span <= total_frames - layer.start_frame) {
+                if (new_span <= total_frames - layer.start_frame)
                   s_live_span = new_span;
-                  update_layer_span(g_project.db.get(), layer_id, new_span);
-                }
               }
-              if (!ImGui::IsMouseDown(0))
+              if (!ImGui::IsMouseDown(0)) {
+                if (s_live_start != layer.start_frame || s_live_span != layer.frame_span)
+                  g_project.model.update_layer_extent(layer_id, s_live_start, s_live_span);
                 s_resize_layer_id = 0;
+              }
             } else if (ImGui::IsMouseClicked(0) && (on_left_edge || on_right_edge)) {
               s_resize_layer_id = layer_id;
               s_resize_left = on_left_edge;
@@ -1430,16 +1117,18 @@ if (ImGui::Button(ICON_FA_TIMES " Cancel", ImVec2(80, 0))) {
               int new_span = layer.frame_span;
               int new_start = std::max(0, std::min(frame, total_frames - new_span));
               s_live_start = new_start;
-              update_layer_start_frame(g_project.db.get(), layer_id, new_start);
-              if (!ImGui::IsMouseDown(0))
+              if (!ImGui::IsMouseDown(0)) {
+                if (s_live_start != layer.start_frame)
+                  g_project.model.update_layer_start_frame(layer_id, s_live_start);
                 s_dragging_layer_id = 0;
+              }
             } else {
               ImGui::SetCursorScreenPos(b0);
               ImGui::InvisibleButton("##clip", ImVec2(b1.x - b0.x, b1.y - b0.y));
               if (ImGui::IsItemClicked(0) && s_dragging_layer_id == 0 && s_resize_layer_id == 0) {
                 s_selected_layer_id = layer_id;
                 s_selected_layer_scene_id = s_selected_scene_id;
-                s_selected_media_path.clear();
+                s_selected_media_id = 0;
               }
               if (ImGui::IsItemHovered() && !on_left_edge && !on_right_edge)
                 ImGui::SetMouseCursor(ImGuiMouseCursor_Hand);
@@ -1447,8 +1136,14 @@ if (ImGui::Button(ICON_FA_TIMES " Cancel", ImVec2(80, 0))) {
                 s_dragging_layer_id = layer_id;
             }
 
+            // Crop from the stored image size when known, so the UVs do not wait for the thumbnail decode.
+            const MediaRow* clip_media = g_project.model.find_media(layer.media_id);
             int thumb_w = 0, thumb_h = 0;
-            ImTextureID clip_tex = get_thumbnail_texture(g_project.path, layer.image_path, &thumb_w, &thumb_h);
+            ImTextureID clip_tex = clip_media ? get_thumbnail_texture(g_project.path, *clip_media, &thumb_w, &thumb_h) : nullptr;
+            if (clip_media && clip_media->width > 0 && clip_media->height > 0) {
+              thumb_w = clip_media->width;
+              thumb_h = clip_media->height;
+            }
             if (clip_tex) {
               float clip_w = b1.x - b0.x, clip_h = b1.y - b0.y;
               float uv_left = 0.f, uv_right = 1.f, uv_top = 0.f, uv_bottom = 1.f;
@@ -1474,14 +1169,21 @@ if (ImGui::Button(ICON_FA_TIMES " Cancel", ImVec2(80, 0))) {
             if (s_selected_layer_id == layer_id)
               dl->AddRect(b0, b1, IM_COL32(255, 255, 0, 255), 0.f, 0, 3.f);
 
-            std::string label_name = fs::path(layer.image_path).filename().string();
-            char buf[256];
-            snprintf(buf, sizeof(buf), "%s  •  %d f", label_name.c_str(), draw_span);
-            ImVec2 tsz = ImGui::CalcTextSize(buf);
+            ClipLabel& label = s_clip_labels[layer_id];
+            static const std::string s_missing_media_name = "(missing media)";
+            const std::string& clip_name = clip_media ? clip_media->name : s_missing_media_name;
+            if (label.text.empty() || label.span != draw_span || label.name != clip_name) {
+              char buf[256];
+              snprintf(buf, sizeof(buf), "%s  •  %d f", clip_name.c_str(), draw_span);
+              label.name = clip_name;
+              label.span = draw_span;
+              label.text = buf;
+              label.size = ImGui::CalcTextSize(buf);
+            }
             const float pad = 5.f;
-            ImVec2 tpos(b0.x + pad, (b0.y + b1.y - tsz.y) * 0.5f);
+            ImVec2 tpos(b0.x + pad, (b0.y + b1.y - label.size.y) * 0.5f);
             ImVec4 clip_rect(b0.x + pad, b0.y, b1.x - pad, b1.y);
-            dl->AddText(ImGui::GetFont(), ImGui::GetFontSize(), tpos, IM_COL32(255, 255, 255, 255), buf, nullptr, 0.f, &clip_rect);
+            dl->AddText(ImGui::GetFont(), ImGui::GetFontSize(), tpos, IM_COL32(255, 255, 255, 255), label.text.c_str(), nullptr, 0.f, &clip_rect);
 
             ImGui::PopID();
           }
@@ -1513,7 +1215,13 @@ void render_frame(GLFWwindow* window) {
 
 }  // namespace
 
-int main() {
+int main(int argc, char** argv) {
+  if (is_cli_invocation(argc, argv)) {
+    int status = run_cli(argc, argv, create_gpu_frame_scaler);
+    glfwTerminate();
+    return status;
+  }
+
   if (!glfwInit())
     return 1;
 
@@ -1526,53 +1234,43 @@ int main() {
 
   init_imgui(window);
   glfwSetDropCallback(window, drop_callback);
+  if (const char* mb = std::getenv("CHYA_THUMB_CACHE_MB")) {
+    long v = std::strtol(mb, nullptr, 10);
+    if (v > 0) set_thumbnail_cache_budget(static_cast<size_t>(v) << 20);
+  }
 
   while (!glfwWindowShouldClose(window)) {
     glfwPollEvents();
 
     if (g_play_window) {
-      if (glfwWindowShouldClose(g_play_window)) {
-        glfwDestroyWindow(g_play_window);
-        g_play_window = nullptr;
+      if (glfwWindowShouldClose(g_play_window) || !g_project.db) {
+        close_play_window();
       } else {
-        MovieConfig cfg = get_movie_config(g_project.db.get());
-        const int total_frames = get_scene_used_frame_count(g_project.db.get(), g_play_scene_id);
-        double now = glfwGetTime();
-        double elapsed = now - g_play_start_time;
-        int frame = total_frames > 0 ? (static_cast<int>(elapsed * cfg.frame_rate) % total_frames) : 0;
-        std::string path = get_image_at_frame(g_project.db.get(), g_play_scene_id, frame);
-        GLuint tex = 0;
-        if (!path.empty()) {
-          ImTextureID tid = get_thumbnail_texture(g_project.path, path);
-          if (tid) tex = (GLuint)(intptr_t)tid;
-        }
-
-        glfwMakeContextCurrent(g_play_window);
         int pw = 0, ph = 0;
         glfwGetFramebufferSize(g_play_window, &pw, &ph);
-        glViewport(0, 0, pw, ph);
-        glClearColor(0.1f, 0.1f, 0.12f, 1.f);
-        glClear(GL_COLOR_BUFFER_BIT);
-        if (tex != 0 && g_project.db) {
-          if (g_quad_program == 0)
-            g_quad_program = create_quad_program();
-          if (g_quad_program != 0)
-            draw_textured_quad(g_quad_program, tex);
+        g_playback.set_framebuffer_size(pw, ph);
+        if (g_project.model.frame_index(g_play_scene_id).revision != g_play_scene_revision || !(g_project.model.config() == g_play_config))
+          start_playback(g_playback.current_frame());
+        const double now = glfwGetTime();
+        if (now - g_play_title_time > 0.5) {
+          PlaybackStats ps = g_playback.stats();
+          char title[160];
+          snprintf(title, sizeof(title), "Timeline playback  |  frame %d  |  %llu late, %llu dropped  |  %d/%d buffered",
+                   g_playback.current_frame(), (unsigned long long)ps.late, (unsigned long long)ps.dropped, ps.buffered, ps.ring_size);
+          glfwSetWindowTitle(g_play_window, title);
+          g_play_title_time = now;
         }
-        glfwSwapBuffers(g_play_window);
-        glfwMakeContextCurrent(window);
       }
     }
 
+    upload_pending_thumbnails();
     begin_frame();
     draw_ui();
     render_frame(window);
   }
 
-  if (g_play_window) {
-    glfwDestroyWindow(g_play_window);
-    g_play_window = nullptr;
-  }
+  close_project();
+  shutdown_thumbnail_loader();
   shutdown_imgui();
   glfwDestroyWindow(window);
   glfwTerminate();
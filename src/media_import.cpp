@@ -0,0 +1,312 @@
+#include "media_import.h"
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cstdio>
+#include <filesystem>
+#include <functional>
+#include <system_error>
+#include "content_hash.h"
+#include "stb_image.h"
+#if defined(__linux__)
+#include <linux/fs.h>
+#include <sys/ioctl.h>
+#endif
+#if defined(__APPLE__)
+#include <sys/clonefile.h>
+#endif
+
+namespace fs = std::filesystem;
+
+namespace {
+
+// Copies are mostly waiting on the disk; past a few threads they only compete for it.
+constexpr unsigned kMaxImportWorkers = 4;
+// Names tried for one content hash (<hash><ext>, <hash>-1<ext>, ...) before an import gives up.
+constexpr int kMaxNameCollisions = 100;
+constexpr size_t kCopyChunk = 1 << 20;
+
+std::atomic<unsigned> g_temp_counter{0};
+
+// Creates a new, empty temporary file in dir ("x" mode never opens an existing one).
+FILE* create_temp(const fs::path& dir, fs::path* path) {
+  const std::string tag = std::to_string(std::hash<std::thread::id>{}(std::this_thread::get_id()) & 0xffffff);
+  for (int attempt = 0; attempt < 100; attempt++) {
+    *path = dir / (".import-" + tag + "-" + std::to_string(g_temp_counter++) + ".tmp");
+    if (FILE* f = std::fopen(path->string().c_str(), "wbx")) return f;
+  }
+  return nullptr;
+}
+
+// Makes the empty file *out at dst a clone of src when the filesystem supports it; *out may be reopened.
+bool clone_into(FILE* in, FILE** out, const fs::path& src, const fs::path& dst) {
+#if defined(__linux__)
+  (void)src;
+  (void)dst;
+  // A reflink shares the source's extents (btrfs, XFS, bcachefs): no data is written.
+  return ioctl(fileno(*out), FICLONE, fileno(in)) == 0;
+#elif defined(__APPLE__)
+  (void)in;
+  // clonefile only creates new files, so the placeholder is swapped for the clone.
+  std::fclose(*out);
+  *out = nullptr;
+  std::error_code ec;
+  fs::remove(dst, ec);
+  if (clonefile(src.c_str(), dst.c_str(), CLONE_NOFOLLOW) == 0) return true;
+  *out = std::fopen(dst.c_str(), "wbx");
+  return false;
+#else
+  (void)in;
+  (void)out;
+  (void)src;
+  (void)dst;
+  return false;
+#endif
+}
+
+// Reads in to the end, hashing every chunk and writing it to out unless out is null.
+bool stream_file(FILE* in, FILE* out, ContentHasher* hasher, int64_t* size) {
+  std::vector<unsigned char> buf(kCopyChunk);
+  *size = 0;
+  for (;;) {
+    const size_t n = std::fread(buf.data(), 1, buf.size(), in);
+    if (n == 0) return !std::ferror(in);
+    hasher->update(buf.data(), n);
+    *size += static_cast<int64_t>(n);
+    if (out && std::fwrite(buf.data(), 1, n, out) != n) return false;
+  }
+}
+
+int64_t file_mtime(const fs::path& path, std::error_code& ec) {
+  return static_cast<int64_t>(fs::last_write_time(path, ec).time_since_epoch().count());
+}
+
+void probe_image_header(const fs::path& path, MediaRow* row) {
+  if (!stbi_info(path.string().c_str(), &row->width, &row->height, &row->channels))
+    row->width = row->height = row->channels = 0;
+}
+
+// True if the file holds exactly size bytes with the given hash. A stored file edited in place keeps its
+// content-addressed name, so the name alone does not prove what the file holds.
+bool file_has_content(const fs::path& path, int64_t size, const std::string& hash) {
+  std::error_code ec;
+  const uintmax_t on_disk = fs::file_size(path, ec);
+  if (ec || static_cast<int64_t>(on_disk) != size) return false;
+  FILE* in = std::fopen(path.string().c_str(), "rb");
+  if (!in) return false;
+  ContentHasher hasher;
+  int64_t read = 0;
+  const bool ok = stream_file(in, nullptr, &hasher, &read);
+  std::fclose(in);
+  return ok && read == size && content_hash_hex(hasher.digest()) == hash;
+}
+
+std::string lower_extension(const std::string& path) {
+  std::string ext = fs::path(path).extension().string();
+  std::transform(ext.begin(), ext.end(), ext.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+  return ext;
+}
+
+}  // namespace
+
+bool store_media_file(const std::string& project_root, const std::string& src, ImportedMedia* out) {
+  if (project_root.empty() || !out) return false;
+  const fs::path media_dir = fs::path(project_root) / "media";
+  FILE* in = std::fopen(src.c_str(), "rb");
+  if (!in) return false;
+  fs::path tmp;
+  FILE* dst = create_temp(media_dir, &tmp);
+  if (!dst) {
+    std::fclose(in);
+    return false;
+  }
+  const bool cloned = clone_into(in, &dst, fs::path(src), tmp);
+  // One pass over the source: every chunk read is hashed and, unless the file was cloned, written out.
+  ContentHasher hasher;
+  int64_t size = 0;
+  bool ok = (cloned || dst) && stream_file(in, cloned ? nullptr : dst, &hasher, &size);
+  std::fclose(in);
+  if (dst && std::fclose(dst) != 0) ok = false;
+  std::error_code ec;
+  if (!ok) {
+    fs::remove(tmp, ec);
+    return false;
+  }
+  const std::string hash = content_hash_hex(hasher.digest());
+  const std::string ext = lower_extension(src);
+  // The first free name, or one whose file still holds these exact contents. A taken name whose file was
+  // edited since it was stored moves the import on to <hash>-<n><ext>.
+  fs::path final_path;
+  bool stored_before = false;
+  for (int n = 0;; n++) {
+    if (n == kMaxNameCollisions) {
+      fs::remove(tmp, ec);
+      return false;
+    }
+    final_path = media_dir / (hash + (n > 0 ? "-" + std::to_string(n) : std::string()) + ext);
+    if (!fs::exists(final_path, ec)) break;
+    if (file_has_content(final_path, size, hash)) {
+      stored_before = true;
+      break;
+    }
+  }
+  if (stored_before) {
+    // Same contents stored before: keep that file (its mtime, and so any cached thumbnail, stays valid).
+    fs::remove(tmp, ec);
+  } else {
+    fs::rename(tmp, final_path, ec);
+    if (ec) {
+      fs::remove(tmp, ec);
+      return false;
+    }
+  }
+  MediaRow& m = out->media;
+  m = MediaRow();
+  m.path = "media/" + final_path.filename().string();
+  m.name = fs::path(src).filename().string();
+  m.hash = hash;
+  m.size = size;
+  m.mtime = file_mtime(final_path, ec);
+  probe_image_header(final_path, &m);
+  out->source_path = src;
+  return true;
+}
+
+bool refresh_media_metadata(const std::string& project_root, MediaRow* row) {
+  if (!row || row->path.empty()) return false;
+  const fs::path full = fs::path(project_root) / row->path;
+  std::error_code ec;
+  const int64_t mtime = file_mtime(full, ec);
+  if (ec) return false;
+  const bool modified = mtime != row->mtime;
+  if (!modified && row->width > 0 && !row->hash.empty()) return false;
+  MediaRow updated = *row;
+  if (modified || updated.hash.empty()) {
+    FILE* in = std::fopen(full.string().c_str(), "rb");
+    if (!in) return false;
+    ContentHasher hasher;
+    const bool ok = stream_file(in, nullptr, &hasher, &updated.size);
+    std::fclose(in);
+    if (!ok) return false;
+    updated.hash = content_hash_hex(hasher.digest());
+  }
+  probe_image_header(full, &updated);
+  updated.mtime = mtime;
+  // An unreadable image with current fields is probed again next time but not rewritten.
+  const bool changed = updated.hash != row->hash || updated.size != row->size || updated.width != row->width ||
+                       updated.height != row->height || updated.channels != row->channels || updated.mtime != row->mtime;
+  *row = std::move(updated);
+  return changed;
+}
+
+int revalidate_media(sqlite3* db, const std::string& project_root, const std::atomic<bool>* cancel) {
+  if (!db || project_root.empty()) return -1;
+  std::vector<MediaRow> changed;
+  for (MediaRow& m : list_media(db)) {
+    if (cancel && cancel->load()) break;
+    if (refresh_media_metadata(project_root, &m)) changed.push_back(std::move(m));
+  }
+  if (!update_media_metadata(db, changed)) return -1;
+  return static_cast<int>(changed.size());
+}
+
+MediaImporter::~MediaImporter() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+    jobs_.clear();
+  }
+  work_cv_.notify_all();
+  for (std::thread& t : workers_)
+    t.join();
+}
+
+bool MediaImporter::add(const std::string& project_root, const std::vector<std::string>& source_paths) {
+  if (project_root.empty()) return false;
+  std::lock_guard<std::mutex> lock(mutex_);
+  const bool idle = jobs_.empty() && active_ == 0;
+  if (!idle && project_root != root_) return false;
+  if (idle) {
+    root_ = project_root;
+    std::error_code ec;
+    fs::create_directories(fs::path(root_) / "media", ec);
+  }
+  for (const std::string& p : source_paths) {
+    Job job;
+    job.index = static_cast<int>(finished_.size());
+    job.source_path = p;
+    finished_.push_back(ImportedMedia());
+    jobs_.push_back(std::move(job));
+  }
+  const unsigned hw = std::max(1u, std::thread::hardware_concurrency());
+  const size_t want = std::min<size_t>(std::min(kMaxImportWorkers, hw), jobs_.size() + active_);
+  while (workers_.size() < want)
+    workers_.emplace_back(&MediaImporter::worker, this);
+  work_cv_.notify_all();
+  return true;
+}
+
+void MediaImporter::worker() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  for (;;) {
+    work_cv_.wait(lock, [&] { return stop_ || !jobs_.empty(); });
+    if (stop_) return;
+    Job job = std::move(jobs_.front());
+    jobs_.pop_front();
+    active_++;
+    const std::string root = root_;
+    lock.unlock();
+    ImportedMedia stored;
+    const bool ok = store_media_file(root, job.source_path, &stored);
+    lock.lock();
+    if (ok)
+      finished_[job.index] = std::move(stored);
+    else
+      failed_++;
+    done_++;
+    active_--;
+    if (jobs_.empty() && active_ == 0) idle_cv_.notify_all();
+  }
+}
+
+MediaImportProgress MediaImporter::progress() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  MediaImportProgress p;
+  p.total = static_cast<int>(finished_.size());
+  p.done = done_;
+  p.failed = failed_;
+  return p;
+}
+
+bool MediaImporter::busy() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return !jobs_.empty() || active_ > 0;
+}
+
+bool MediaImporter::take_finished(std::vector<ImportedMedia>* out, int* failed) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (!jobs_.empty() || active_ > 0 || finished_.empty()) return false;
+  if (out) {
+    out->clear();
+    for (ImportedMedia& m : finished_)
+      if (!m.media.path.empty()) out->push_back(std::move(m));
+  }
+  if (failed) *failed = failed_;
+  finished_.clear();
+  done_ = 0;
+  failed_ = 0;
+  return true;
+}
+
+void MediaImporter::cancel() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  // Dropped files count as neither copied nor failed, so the batch shrinks to what was actually attempted.
+  std::vector<bool> dropped(finished_.size(), false);
+  for (const Job& job : jobs_) dropped[job.index] = true;
+  jobs_.clear();
+  idle_cv_.wait(lock, [&] { return active_ == 0; });
+  std::vector<ImportedMedia> kept;
+  for (size_t i = 0; i < finished_.size(); i++)
+    if (!dropped[i]) kept.push_back(std::move(finished_[i]));
+  finished_ = std::move(kept);
+}
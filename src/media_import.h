@@ -0,0 +1,85 @@
+#pragma once
+#include <sqlite3.h>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "project_db.h"
+
+// Files under a project's media/ folder: storing imports on worker threads and keeping the metadata in the
+// media table in step with the files. The importer never touches the database; the UI thread records a
+// finished batch itself (see add_media_rows).
+
+// A file stored in the project.
+struct ImportedMedia {
+  std::string source_path;
+  MediaRow media;  // everything but id; path is "media/<hash><ext>", name the source file name
+};
+
+struct MediaImportProgress {
+  int total = 0;   // files queued since the last finished batch
+  int done = 0;    // stored or failed
+  int failed = 0;
+};
+
+// Stores src under <project_root>/media, named by the hash of its contents and its lower-cased extension, and
+// fills *out. The hash is computed while the data streams through, so the source is read once; where the
+// filesystem can clone files (FICLONE on Linux, clonefile on macOS) the copy is a clone and only the hash
+// reads the data. A file with the same contents already stored (its size and hash are checked, since a
+// stored file may have been edited in place) is left as is and the new copy is dropped; when the name is
+// taken by an edited file, the copy is stored as <hash>-<n><ext> instead.
+// Dimensions and channels come from the image header (stbi_info), without decoding pixels. A failed store
+// leaves nothing behind.
+bool store_media_file(const std::string& project_root, const std::string& src, ImportedMedia* out);
+
+// Brings row's metadata up to date with its file. Nothing is read while the file's mtime matches the row's
+// and the row is complete; otherwise the header is probed again, and the file is rehashed when its mtime
+// changed or the row has no hash. Returns true if row changed; a missing file leaves it as is.
+bool refresh_media_metadata(const std::string& project_root, MediaRow* row);
+// refresh_media_metadata for every media row, writing the changed ones back in one transaction. Stops early
+// (keeping what was refreshed) once *cancel is set. Returns the number of rows updated, -1 on error.
+int revalidate_media(sqlite3* db, const std::string& project_root, const std::atomic<bool>* cancel = nullptr);
+
+// Import queue for the editor. add() and the progress calls never wait for a copy.
+class MediaImporter {
+ public:
+  MediaImporter() = default;
+  MediaImporter(const MediaImporter&) = delete;
+  MediaImporter& operator=(const MediaImporter&) = delete;
+  ~MediaImporter();
+
+  // Queues files for storing in project_root. Fails while files for another project are still queued.
+  bool add(const std::string& project_root, const std::vector<std::string>& source_paths);
+  MediaImportProgress progress() const;
+  bool busy() const;
+  // Once every queued file is done, moves the stored ones (in queue order) into *out, resets the progress
+  // and returns true. Returns false while copies are pending or when nothing was queued.
+  bool take_finished(std::vector<ImportedMedia>* out, int* failed = nullptr);
+  // Drops queued files that have not started and waits for the copies in progress. Files already stored are
+  // still returned by take_finished.
+  void cancel();
+
+ private:
+  struct Job {
+    int index = 0;
+    std::string source_path;
+  };
+
+  void worker();
+
+  mutable std::mutex mutex_;
+  std::condition_variable work_cv_;
+  std::condition_variable idle_cv_;
+  std::vector<std::thread> workers_;
+  std::deque<Job> jobs_;
+  std::vector<ImportedMedia> finished_;  // by queue index; empty media.path for failed copies
+  std::string root_;
+  int active_ = 0;
+  int done_ = 0;
+  int failed_ = 0;
+  bool stop_ = false;
+};
@@ -0,0 +1,276 @@
+#include "playback.h"
+#include "imgui_impl_opengl3_loader.h"
+#include <GLFW/glfw3.h>
+#include "gl_util.h"
+#include "composite.h"
+#include "texture_stream.h"
+#include "stbi_image_ptr.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <filesystem>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+// Decoded frames the ring may hold, at the movie resolution.
+constexpr size_t kPrefetchBudgetBytes = size_t(256) << 20;
+
+using Clock = std::chrono::steady_clock;
+
+}  // namespace
+
+void PlaybackEngine::start(GLFWwindow* window, const std::string& project_root, const SceneFrameIndex& scene, const MediaIndex& media, const MovieConfig& cfg, int start_frame) {
+  stop();
+  window_ = window;
+  cfg_ = cfg;
+  total_frames_ = scene.frame_count();
+  start_frame_ = total_frames_ > 0 ? std::clamp(start_frame, 0, total_frames_ - 1) : 0;
+  runs_.clear();
+  first_seq_ = 0;
+  std::vector<int> prev_ids;
+  for (const FrameSegment& seg : scene.segments) {
+    std::vector<int> ids = scene.media_ids(seg);
+    if (!runs_.empty() && ids == prev_ids) continue;
+    Run run;
+    run.first_frame = seg.first_frame;
+    for (int id : ids) {
+      auto it = media.find(id);
+      // A layer whose media row is gone fails to decode like a missing file.
+      run.sources.push_back(it != media.end() ? (fs::path(project_root) / it->second->path).string() : std::string());
+    }
+    runs_.push_back(std::move(run));
+    prev_ids = std::move(ids);
+    if (seg.first_frame <= start_frame_) first_seq_ = runs_.size() - 1;
+  }
+
+  const size_t frame_bytes = static_cast<size_t>(std::max(1, cfg.width)) * std::max(1, cfg.height) * 4;
+  ring_.assign(std::clamp<size_t>(kPrefetchBudgetBytes / frame_bytes, 3, 16), Slot());
+  next_job_ = first_seq_;
+  released_ = first_seq_;
+  buffers_mapped_ = false;
+  decoding_ = 0;
+  stop_ = false;
+  current_frame_ = start_frame_;
+  presented_ = 0;
+  late_ = 0;
+  dropped_ = 0;
+  if (!runs_.empty()) {
+    unsigned n = std::thread::hardware_concurrency();
+    int count = std::clamp(static_cast<int>(n) / 2, 2, 4);
+    for (int i = 0; i < count; i++)
+      workers_.emplace_back(&PlaybackEngine::decode_loop, this);
+  }
+  presenter_ = std::thread(&PlaybackEngine::present_loop, this);
+}
+
+void PlaybackEngine::stop() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  cv_.notify_all();
+  for (std::thread& t : workers_)
+    t.join();
+  workers_.clear();
+  if (presenter_.joinable())
+    presenter_.join();
+}
+
+void PlaybackEngine::set_framebuffer_size(int w, int h) {
+  fb_w_ = w;
+  fb_h_ = h;
+}
+
+PlaybackStats PlaybackEngine::stats() const {
+  PlaybackStats s;
+  s.presented = presented_.load();
+  s.late = late_.load();
+  s.dropped = dropped_.load();
+  std::lock_guard<std::mutex> lock(mutex_);
+  s.ring_size = static_cast<int>(ring_.size());
+  for (const Slot& slot : ring_)
+    if (slot.ready) s.buffered++;
+  return s;
+}
+
+int64_t PlaybackEngine::run_start(uint64_t seq) const {
+  const uint64_t n = runs_.size();
+  return static_cast<int64_t>(seq / n) * total_frames_ + runs_[seq % n].first_frame;
+}
+
+void PlaybackEngine::decode_loop() {
+  const uint64_t ring_size = ring_.size();
+  std::vector<unsigned char> scratch;
+  for (;;) {
+    uint64_t seq = 0;
+    unsigned char* dst = nullptr;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      cv_.wait(lock, [&] { return stop_ || (buffers_mapped_ && next_job_ < released_ + ring_size); });
+      if (stop_) return;
+      seq = next_job_++;
+      dst = ring_[seq % ring_size].pixels;
+      decoding_++;
+    }
+    // The slot and its buffer are ours until we mark it ready: the run that used it last has been released.
+    const Run& run = runs_[seq % runs_.size()];
+    Slot& slot = ring_[seq % ring_size];
+    bool blank = true;
+    if (dst) {
+      std::vector<StbiImage> images(run.sources.size());
+      std::vector<LayerImage> layers(run.sources.size());
+      for (size_t i = 0; i < run.sources.size(); i++) {
+        int comp = 0;
+        images[i].reset(stbi_load(run.sources[i].c_str(), &layers[i].w, &layers[i].h, &comp, 4));
+        layers[i].pixels = images[i].get();
+        if (images[i]) blank = false;
+      }
+      if (!blank)
+        composite_layers(layers.data(), static_cast<int>(layers.size()), dst, cfg_.width, cfg_.height, cfg_.scale_mode, &scratch);
+    }
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      slot.seq = seq;
+      slot.blank = blank;
+      slot.ready = true;
+      decoding_--;
+    }
+    cv_.notify_all();
+  }
+}
+
+void PlaybackEngine::present_loop() {
+  glfwMakeContextCurrent(window_);
+  glfwSwapInterval(1);
+  QuadRenderer quad;
+  const bool can_draw = create_quad_renderer(&quad);
+  const uint64_t ring_size = ring_.size();
+  // One mapped buffer per ring slot. Without one, workers leave every slot blank.
+  TextureStream stream;
+  const bool streaming = !runs_.empty() && cfg_.width > 0 && cfg_.height > 0 && stream.init(cfg_.width, cfg_.height, static_cast<int>(ring_size));
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (size_t i = 0; i < ring_.size(); i++)
+      ring_[i].pixels = streaming ? stream.buffer(static_cast<int>(i)) : nullptr;
+    buffers_mapped_ = true;
+  }
+  cv_.notify_all();
+  bool has_image = false;
+
+  // Hands run seq's slot back to the workers, first starting the upload of its image into the back texture
+  // if upload is set. Returns whether the back texture now holds an image.
+  auto release = [&](uint64_t seq, bool upload) {
+    Slot& slot = ring_[seq % ring_size];
+    const int i = static_cast<int>(seq % ring_size);
+    const bool image = upload && !slot.blank;
+    if (image) stream.upload(i);
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      slot.ready = false;
+      if (image) slot.pixels = stream.buffer(i);
+      released_ = seq + 1;
+    }
+    cv_.notify_all();
+    return image;
+  };
+  auto is_ready = [&](uint64_t seq) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    const Slot& slot = ring_[seq % ring_size];
+    return slot.ready && slot.seq == seq;
+  };
+
+  // Start the clock once the first image is decoded, so playback does not open with late frames.
+  if (!runs_.empty()) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    Slot& first = ring_[first_seq_ % ring_size];
+    cv_.wait(lock, [&] { return stop_ || (first.ready && first.seq == first_seq_); });
+  }
+  const double fps = cfg_.frame_rate > 0. ? cfg_.frame_rate : 24.;
+  const auto t0 = Clock::now() - std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(start_frame_ / fps));
+  int64_t last_frame = start_frame_ - 1;
+  uint64_t cur = first_seq_;
+  bool cur_shown = false;
+  // Run whose image was uploaded ahead of time into the back texture.
+  bool staged = false;
+  uint64_t staged_seq = 0;
+  bool staged_image = false;
+
+  for (;;) {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (stop_) break;
+    }
+    if (!runs_.empty()) {
+      const int64_t frame = static_cast<int64_t>(std::floor(std::chrono::duration<double>(Clock::now() - t0).count() * fps));
+      const bool new_frame = frame > last_frame;
+      if (new_frame) {
+        if (frame - last_frame > 1)
+          dropped_ += static_cast<uint64_t>(frame - last_frame - 1);
+        last_frame = frame;
+        current_frame_ = static_cast<int>(frame % total_frames_);
+      }
+      // Move to the run covering this frame. Runs are released in order, so one whose frames already passed
+      // is skipped once decoded, without uploading it.
+      for (;;) {
+        const bool passed = frame >= run_start(cur + 1);
+        if (!cur_shown) {
+          bool image = false;
+          if (staged && staged_seq == cur) {
+            staged = false;
+            image = staged_image;
+          } else {
+            if (!is_ready(cur)) {
+              if (new_frame) late_++;
+              break;
+            }
+            image = release(cur, !passed);
+          }
+          if (!passed) {
+            if (image) stream.swap();
+            has_image = image;
+            cur_shown = true;
+          }
+        }
+        if (!passed) {
+          if (new_frame) presented_++;
+          break;
+        }
+        cur++;
+        cur_shown = false;
+      }
+      // Upload the next run while this one is on screen, so its frame only needs a texture swap.
+      if (cur_shown && !staged && is_ready(cur + 1)) {
+        staged_image = release(cur + 1, true);
+        staged_seq = cur + 1;
+        staged = true;
+      }
+    }
+
+    const int fb_w = fb_w_.load(), fb_h = fb_h_.load();
+    glViewport(0, 0, fb_w, fb_h);
+    glClearColor(0.1f, 0.1f, 0.12f, 1.f);
+    glClear(GL_COLOR_BUFFER_BIT);
+    if (has_image && can_draw && fb_w > 0 && fb_h > 0 && cfg_.width > 0 && cfg_.height > 0) {
+      // Letterbox to the movie's aspect ratio.
+      int vw = fb_w, vh = static_cast<int>(static_cast<int64_t>(fb_w) * cfg_.height / cfg_.width);
+      if (vh > fb_h) {
+        vh = fb_h;
+        vw = static_cast<int>(static_cast<int64_t>(fb_h) * cfg_.width / cfg_.height);
+      }
+      glViewport((fb_w - vw) / 2, (fb_h - vh) / 2, vw, vh);
+      draw_textured_quad(quad, stream.front_texture());
+    }
+    glfwSwapBuffers(window_);
+  }
+
+  // Buffers stay mapped until no worker can still be writing into one.
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    cv_.wait(lock, [&] { return decoding_ == 0; });
+  }
+  stream.destroy();
+  destroy_quad_renderer(&quad);
+  glfwMakeContextCurrent(nullptr);
+}
@@ -0,0 +1,86 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "project_db.h"
+
+struct GLFWwindow;
+
+struct PlaybackStats {
+  uint64_t presented = 0;  // frames that were on screen when they came due
+  uint64_t late = 0;       // frames that came due before their image was decoded
+  uint64_t dropped = 0;    // frames that came and went between two presents (missed refreshes)
+  int buffered = 0;        // decoded images waiting in the prefetch ring
+  int ring_size = 0;
+};
+
+// Loops one scene in a window, independently of the UI thread. Decode workers prefetch the layers of upcoming
+// frames, composited and scaled to the movie size like export, straight into a ring of mapped pixel buffers
+// (TextureStream); a presenter thread owns the window's GL context, uploads the next image asynchronously while
+// the current one is on screen and swaps it in when its frame comes due at cfg.frame_rate, paced by the
+// window's vsync. Between start() and stop() no other thread may make the window's context current.
+class PlaybackEngine {
+ public:
+  PlaybackEngine() = default;
+  PlaybackEngine(const PlaybackEngine&) = delete;
+  PlaybackEngine& operator=(const PlaybackEngine&) = delete;
+  ~PlaybackEngine() { stop(); }
+
+  // Starts playing scene from start_frame. Stops any previous playback first.
+  // media resolves the scene's media ids to files; it is only read during the call.
+  void start(GLFWwindow* window, const std::string& project_root, const SceneFrameIndex& scene, const MediaIndex& media, const MovieConfig& cfg, int start_frame = 0);
+  void stop();
+  bool running() const { return presenter_.joinable(); }
+  // Scene frame on screen.
+  int current_frame() const { return current_frame_.load(); }
+  // The window's framebuffer size, which only the main thread may query. Call every frame.
+  void set_framebuffer_size(int w, int h);
+  PlaybackStats stats() const;
+
+ private:
+  // Consecutive frames showing the same layers; decoded and composited once per pass through the scene.
+  struct Run {
+    std::vector<std::string> sources;  // absolute image paths, bottom to top; empty for a blank frame
+    int first_frame = 0;
+  };
+  struct Slot {
+    uint64_t seq = 0;
+    bool ready = false;
+    bool blank = true;
+    unsigned char* pixels = nullptr;  // mapped stream buffer of cfg.width x cfg.height, set by the presenter
+  };
+
+  void decode_loop();
+  void present_loop();
+  // Absolute frame (counting from the start of the first pass) at which run number seq starts.
+  int64_t run_start(uint64_t seq) const;
+
+  GLFWwindow* window_ = nullptr;
+  MovieConfig cfg_;
+  std::vector<Run> runs_;
+  int total_frames_ = 0;
+  int start_frame_ = 0;
+  uint64_t first_seq_ = 0;
+
+  mutable std::mutex mutex_;
+  std::condition_variable cv_;
+  std::vector<Slot> ring_;  // slot seq % ring_.size() holds run number seq
+  uint64_t next_job_ = 0;   // next run number handed to a decode worker
+  uint64_t released_ = 0;   // runs before this one have been uploaded or skipped by the presenter
+  bool buffers_mapped_ = false;  // the presenter has set up the stream buffers
+  int decoding_ = 0;        // workers writing into a stream buffer
+  bool stop_ = false;
+
+  std::atomic<int> fb_w_{0};
+  std::atomic<int> fb_h_{0};
+  std::atomic<int> current_frame_{0};
+  std::atomic<uint64_t> presented_{0};
+  std::atomic<uint64_t> late_{0};
+  std::atomic<uint64_t> dropped_{0};
+  std::vector<std::thread> workers_;
+  std::thread presenter_;
+};
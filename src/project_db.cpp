@@ -0,0 +1,605 @@
+#include "project_db.h"
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+#include <map>
+#include <mutex>
+#include <set>
+#include <utility>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+// Prepared statements per connection, keyed by the address of their SQL string literal. Each connection is
+// only used from one thread at a time; the mutex guards the maps themselves.
+std::mutex g_stmt_mutex;
+std::map<sqlite3*, std::map<const char*, sqlite3_stmt*>> g_stmt_cache;
+
+// A cached statement checked out for one use: reset and its bindings cleared when it goes out of scope.
+// sql must be a string literal.
+class CachedStmt {
+ public:
+  CachedStmt(sqlite3* db, const char* sql) {
+    if (!db) return;
+    std::lock_guard<std::mutex> lock(g_stmt_mutex);
+    sqlite3_stmt*& slot = g_stmt_cache[db][sql];
+    if (!slot && sqlite3_prepare_v3(db, sql, -1, SQLITE_PREPARE_PERSISTENT, &slot, nullptr) != SQLITE_OK)
+      slot = nullptr;
+    stmt_ = slot;
+  }
+  ~CachedStmt() {
+    if (stmt_) {
+      sqlite3_reset(stmt_);
+      sqlite3_clear_bindings(stmt_);
+    }
+  }
+  CachedStmt(const CachedStmt&) = delete;
+  CachedStmt& operator=(const CachedStmt&) = delete;
+
+  explicit operator bool() const { return stmt_ != nullptr; }
+  sqlite3_stmt* get() const { return stmt_; }
+
+  void bind(int i, int v) { sqlite3_bind_int(stmt_, i, v); }
+  void bind(int i, int64_t v) { sqlite3_bind_int64(stmt_, i, v); }
+  void bind(int i, double v) { sqlite3_bind_double(stmt_, i, v); }
+  void bind(int i, const std::string& v) { sqlite3_bind_text(stmt_, i, v.data(), static_cast<int>(v.size()), SQLITE_TRANSIENT); }
+  bool step_row() { return sqlite3_step(stmt_) == SQLITE_ROW; }
+  // Runs a statement that returns no rows.
+  bool exec() { return sqlite3_step(stmt_) == SQLITE_DONE; }
+
+  int column_int(int i) const { return sqlite3_column_int(stmt_, i); }
+  int64_t column_int64(int i) const { return sqlite3_column_int64(stmt_, i); }
+  double column_double(int i) const { return sqlite3_column_double(stmt_, i); }
+  std::string column_text(int i) const {
+    const char* t = reinterpret_cast<const char*>(sqlite3_column_text(stmt_, i));
+    return t ? t : "";
+  }
+
+ private:
+  sqlite3_stmt* stmt_ = nullptr;
+};
+
+}  // namespace
+
+void close_db(sqlite3* db) {
+  if (!db) return;
+  {
+    std::lock_guard<std::mutex> lock(g_stmt_mutex);
+    auto it = g_stmt_cache.find(db);
+    if (it != g_stmt_cache.end()) {
+      for (auto& p : it->second)
+        sqlite3_finalize(p.second);
+      g_stmt_cache.erase(it);
+    }
+  }
+  sqlite3_close(db);
+}
+
+bool run_sql(sqlite3* db, const char* sql) {
+  char* err = nullptr;
+  int r = sqlite3_exec(db, sql, nullptr, nullptr, &err);
+  if (r != SQLITE_OK) {
+    if (err) sqlite3_free(err);
+    return false;
+  }
+  return true;
+}
+
+void configure_connection(sqlite3* db) {
+  if (!db) return;
+  sqlite3_busy_timeout(db, 5000);
+  // WAL lets the render thread's connection read while the editor writes. journal_mode is stored in the
+  // file, so this is a no-op after the first open; if the filesystem cannot do WAL SQLite keeps the old mode.
+  run_sql(db, "PRAGMA journal_mode=WAL");
+  // In WAL mode NORMAL only syncs at checkpoints; a crash can lose the last edits but not corrupt the file.
+  run_sql(db, "PRAGMA synchronous=NORMAL");
+}
+
+namespace {
+
+int schema_version(sqlite3* db) {
+  sqlite3_stmt* stmt = nullptr;
+  if (sqlite3_prepare_v2(db, "PRAGMA user_version", -1, &stmt, nullptr) != SQLITE_OK)
+    return -1;
+  int version = sqlite3_step(stmt) == SQLITE_ROW ? sqlite3_column_int(stmt, 0) : -1;
+  sqlite3_finalize(stmt);
+  return version;
+}
+
+bool has_column(sqlite3* db, const char* table, const char* column) {
+  char* sql = sqlite3_mprintf("SELECT 1 FROM pragma_table_info('%q') WHERE name = '%q'", table, column);
+  sqlite3_stmt* stmt = nullptr;
+  bool found = sql && sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) == SQLITE_OK && sqlite3_step(stmt) == SQLITE_ROW;
+  sqlite3_finalize(stmt);
+  if (sql) sqlite3_free(sql);
+  return found;
+}
+
+bool add_column_if_missing(sqlite3* db, const char* table, const char* column, const char* decl) {
+  if (has_column(db, table, column)) return true;
+  char* sql = sqlite3_mprintf("ALTER TABLE %s ADD COLUMN %s %s", table, column, decl);
+  bool ok = sql && run_sql(db, sql);
+  if (sql) sqlite3_free(sql);
+  return ok;
+}
+
+// Version 1: the tables and default rows. Projects created before versioning (user_version 0) may lack
+// columns added over time, so those are added when missing.
+bool migrate_base_tables(sqlite3* db) {
+  const char* schema =
+      "CREATE TABLE IF NOT EXISTS projects("
+      "  id INTEGER PRIMARY KEY, name TEXT NOT NULL, path TEXT NOT NULL);"
+      "CREATE TABLE IF NOT EXISTS timeline("
+      "  id INTEGER PRIMARY KEY);"
+      "CREATE TABLE IF NOT EXISTS scenes("
+      "  id INTEGER PRIMARY KEY, timeline_id INTEGER NOT NULL, sort_order INTEGER NOT NULL, name TEXT);"
+      "CREATE TABLE IF NOT EXISTS layers("
+      "  id INTEGER PRIMARY KEY, scene_id INTEGER NOT NULL, image_path TEXT NOT NULL, sort_order INTEGER NOT NULL,"
+      "  frame_span INTEGER NOT NULL DEFAULT 1);"
+      "CREATE TABLE IF NOT EXISTS media("
+      "  id INTEGER PRIMARY KEY, path TEXT NOT NULL);"
+      "CREATE TABLE IF NOT EXISTS movie_config("
+      "  id INTEGER PRIMARY KEY CHECK (id = 1), duration_sec REAL NOT NULL DEFAULT 10,"
+      "  frame_rate REAL NOT NULL DEFAULT 24, width INTEGER NOT NULL DEFAULT 1920, height INTEGER NOT NULL DEFAULT 1080,"
+      "  scale_mode INTEGER NOT NULL DEFAULT 0);";
+  return run_sql(db, schema) &&
+         add_column_if_missing(db, "scenes", "name", "TEXT") &&
+         add_column_if_missing(db, "layers", "frame_span", "INTEGER NOT NULL DEFAULT 1") &&
+         add_column_if_missing(db, "movie_config", "scale_mode", "INTEGER NOT NULL DEFAULT 0") &&
+         run_sql(db,
+                 "INSERT OR IGNORE INTO timeline(id) VALUES(1);"
+                 "INSERT OR IGNORE INTO movie_config(id, duration_sec, frame_rate, width, height) VALUES(1, 10, 24, 1920, 1080);");
+}
+
+// Version 2: indexes for per-scene layer listing and lookups by media path.
+bool migrate_add_indexes(sqlite3* db) {
+  return run_sql(db,
+                 "CREATE INDEX IF NOT EXISTS layers_scene_order ON layers(scene_id, sort_order);"
+                 "CREATE INDEX IF NOT EXISTS layers_image_path ON layers(image_path);"
+                 "CREATE INDEX IF NOT EXISTS media_path ON media(path);");
+}
+
+// Version 3: content-addressed media. Imports are stored as media/<hash><ext>; name is what the UI shows
+// (the imported file's name until renamed). Rows from older versions keep their path, use its file name as
+// name and have no hash yet.
+bool migrate_media_content_hash(sqlite3* db) {
+  return add_column_if_missing(db, "media", "name", "TEXT") &&
+         add_column_if_missing(db, "media", "hash", "TEXT") &&
+         add_column_if_missing(db, "media", "size", "INTEGER") &&
+         run_sql(db,
+                 "UPDATE media SET name = substr(path, length(rtrim(path, replace(path, '/', ''))) + 1) WHERE name IS NULL;"
+                 "CREATE INDEX IF NOT EXISTS media_hash ON media(hash);");
+}
+
+// Version 4: image metadata read from file headers, so layout and memory estimates need no decode. Older
+// rows have mtime 0 until they are revalidated.
+bool migrate_media_metadata(sqlite3* db) {
+  return add_column_if_missing(db, "media", "width", "INTEGER") &&
+         add_column_if_missing(db, "media", "height", "INTEGER") &&
+         add_column_if_missing(db, "media", "channels", "INTEGER") &&
+         add_column_if_missing(db, "media", "mtime", "INTEGER");
+}
+
+// Version 5: layers reference media by id instead of repeating its path. Layer paths missing from media
+// (their media was deleted from the library) get unlisted media rows. The table is rebuilt so image_path
+// is gone for good, which needs no DROP COLUMN support.
+bool migrate_layers_media_id(sqlite3* db) {
+  return add_column_if_missing(db, "media", "listed", "INTEGER NOT NULL DEFAULT 1") &&
+         run_sql(db,
+                 "INSERT INTO media(path, name, listed) "
+                 "  SELECT DISTINCT image_path, substr(image_path, length(rtrim(image_path, replace(image_path, '/', ''))) + 1), 0"
+                 "  FROM layers WHERE image_path NOT IN (SELECT path FROM media);"
+                 "CREATE TABLE layers_v5("
+                 "  id INTEGER PRIMARY KEY, scene_id INTEGER NOT NULL, media_id INTEGER NOT NULL REFERENCES media(id),"
+                 "  sort_order INTEGER NOT NULL, frame_span INTEGER NOT NULL DEFAULT 1);"
+                 "INSERT INTO layers_v5(id, scene_id, media_id, sort_order, frame_span)"
+                 "  SELECT id, scene_id, (SELECT MIN(m.id) FROM media m WHERE m.path = layers.image_path), sort_order,"
+                 "         COALESCE(frame_span, 1) FROM layers;"
+                 "DROP TABLE layers;"
+                 "ALTER TABLE layers_v5 RENAME TO layers;"
+                 "CREATE INDEX layers_scene_order ON layers(scene_id, sort_order);"
+                 "CREATE INDEX layers_media ON layers(media_id);");
+}
+
+// Schema steps in order; step i upgrades user_version i to i + 1. Append only, never edit a shipped step.
+bool (*const kMigrations[])(sqlite3*) = {
+    migrate_base_tables,
+    migrate_add_indexes,
+    migrate_media_content_hash,
+    migrate_media_metadata,
+    migrate_layers_media_id,
+};
+constexpr int kSchemaVersion = static_cast<int>(sizeof(kMigrations) / sizeof(kMigrations[0]));
+
+}  // namespace
+
+bool init_schema(sqlite3* db) {
+  configure_connection(db);
+  int version = schema_version(db);
+  if (version < 0 || version > kSchemaVersion)
+    return false;  // unreadable, or written by a newer chya
+  for (; version < kSchemaVersion; version++) {
+    // Each step and its version bump commit together, so an interrupted upgrade resumes at the failed step.
+    if (!run_sql(db, "BEGIN IMMEDIATE"))
+      return false;
+    char pragma[48];
+    snprintf(pragma, sizeof(pragma), "PRAGMA user_version = %d", version + 1);
+    if (!kMigrations[version](db) || !run_sql(db, pragma)) {
+      run_sql(db, "ROLLBACK");
+      return false;
+    }
+    if (!run_sql(db, "COMMIT"))
+      return false;
+  }
+  return true;
+}
+
+MovieConfig get_movie_config(sqlite3* db) {
+  MovieConfig c;
+  CachedStmt stmt(db, "SELECT duration_sec, frame_rate, width, height, scale_mode FROM movie_config WHERE id = 1");
+  if (!stmt) return c;
+  if (stmt.step_row()) {
+    c.duration_sec = stmt.column_double(0);
+    c.frame_rate = stmt.column_double(1);
+    c.width = stmt.column_int(2);
+    c.height = stmt.column_int(3);
+    int mode = stmt.column_int(4);
+    if (mode >= static_cast<int>(ScaleMode::Fit) && mode <= static_cast<int>(ScaleMode::Stretch))
+      c.scale_mode = static_cast<ScaleMode>(mode);
+  }
+  return c;
+}
+bool set_movie_config(sqlite3* db, const MovieConfig& c) {
+  CachedStmt stmt(db,
+      "INSERT INTO movie_config(id, duration_sec, frame_rate, width, height, scale_mode) VALUES(1, ?, ?, ?, ?, ?)"
+      " ON CONFLICT(id) DO UPDATE SET duration_sec=excluded.duration_sec, frame_rate=excluded.frame_rate,"
+      " width=excluded.width, height=excluded.height, scale_mode=excluded.scale_mode");
+  if (!stmt) return false;
+  stmt.bind(1, c.duration_sec);
+  stmt.bind(2, c.frame_rate);
+  stmt.bind(3, c.width);
+  stmt.bind(4, c.height);
+  stmt.bind(5, static_cast<int>(c.scale_mode));
+  return stmt.exec();
+}
+
+std::vector<SceneRow> list_scenes(sqlite3* db) {
+  std::vector<SceneRow> out;
+  CachedStmt stmt(db, "SELECT id, sort_order, COALESCE(name, 'Scene ' || id) FROM scenes ORDER BY sort_order, id");
+  if (!stmt) return out;
+  while (stmt.step_row()) {
+    SceneRow r;
+    r.id = stmt.column_int(0);
+    r.sort_order = stmt.column_int(1);
+    r.name = stmt.column_text(2);
+    out.push_back(r);
+  }
+  return out;
+}
+
+bool create_scene(sqlite3* db) {
+  int next_order = 1;
+  {
+    CachedStmt stmt(db, "SELECT COALESCE(MAX(sort_order), 0) + 1 FROM scenes WHERE timeline_id = 1");
+    if (!stmt) return false;
+    if (stmt.step_row())
+      next_order = stmt.column_int(0);
+  }
+  CachedStmt stmt(db, "INSERT INTO scenes(timeline_id, sort_order, name) VALUES(1, ?1, 'Scene ' || ?1)");
+  if (!stmt) return false;
+  stmt.bind(1, next_order);
+  return stmt.exec();
+}
+
+bool rename_scene(sqlite3* db, int id, const std::string& name) {
+  if (name.empty()) return false;
+  CachedStmt stmt(db, "UPDATE scenes SET name = ? WHERE id = ?");
+  if (!stmt) return false;
+  stmt.bind(1, name);
+  stmt.bind(2, id);
+  return stmt.exec();
+}
+
+bool delete_scene(sqlite3* db, int id) {
+  CachedStmt del_layers(db, "DELETE FROM layers WHERE scene_id = ?");
+  CachedStmt del_scene(db, "DELETE FROM scenes WHERE id = ?");
+  if (!del_layers || !del_scene) return false;
+  del_layers.bind(1, id);
+  del_scene.bind(1, id);
+  return del_layers.exec() && del_scene.exec();
+}
+
+namespace {
+
+// Swaps sort_order with the nearest scene before (direction -1) or after (+1) scene_id.
+bool move_scene(sqlite3* db, int scene_id, int direction) {
+  int order = 0;
+  {
+    CachedStmt stmt(db, "SELECT sort_order FROM scenes WHERE id = ?");
+    if (!stmt) return false;
+    stmt.bind(1, scene_id);
+    if (!stmt.step_row()) return false;
+    order = stmt.column_int(0);
+  }
+  int other_id = 0;
+  {
+    CachedStmt stmt(db, direction < 0 ? "SELECT id FROM scenes WHERE sort_order < ? ORDER BY sort_order DESC LIMIT 1"
+                                      : "SELECT id FROM scenes WHERE sort_order > ? ORDER BY sort_order ASC LIMIT 1");
+    if (!stmt) return false;
+    stmt.bind(1, order);
+    if (!stmt.step_row()) return false;
+    other_id = stmt.column_int(0);
+  }
+  CachedStmt stmt(db, "UPDATE scenes SET sort_order = CASE id WHEN ?1 THEN ?2 WHEN ?3 THEN ?4 END WHERE id IN (?1, ?3)");
+  if (!stmt) return false;
+  stmt.bind(1, scene_id);
+  stmt.bind(2, order + direction);
+  stmt.bind(3, other_id);
+  stmt.bind(4, order);
+  return stmt.exec();
+}
+
+}  // namespace
+
+bool move_scene_up(sqlite3* db, int scene_id) {
+  return move_scene(db, scene_id, -1);
+}
+
+bool move_scene_down(sqlite3* db, int scene_id) {
+  return move_scene(db, scene_id, 1);
+}
+
+std::vector<LayerRow> list_layers(sqlite3* db, int scene_id) {
+  std::vector<LayerRow> out;
+  CachedStmt stmt(db, "SELECT id, media_id, sort_order, COALESCE(frame_span, 1) FROM layers WHERE scene_id = ? ORDER BY sort_order, id");
+  if (!stmt) return out;
+  stmt.bind(1, scene_id);
+  while (stmt.step_row()) {
+    LayerRow r;
+    r.id = stmt.column_int(0);
+    r.media_id = stmt.column_int(1);
+    r.start_frame = stmt.column_int(2);
+    r.frame_span = stmt.column_int(3);
+    if (r.frame_span < 1) r.frame_span = 1;
+    out.push_back(r);
+  }
+  return out;
+}
+
+bool add_layer_at_frame(sqlite3* db, int scene_id, int frame_index, int media_id, int frame_span) {
+  if (frame_index < 0 || frame_span < 1 || media_id <= 0) return false;
+  CachedStmt stmt(db, "INSERT INTO layers(scene_id, media_id, sort_order, frame_span) VALUES(?, ?, ?, ?)");
+  if (!stmt) return false;
+  stmt.bind(1, scene_id);
+  stmt.bind(2, media_id);
+  stmt.bind(3, frame_index);
+  stmt.bind(4, frame_span);
+  return stmt.exec();
+}
+
+bool update_layer_start_frame(sqlite3* db, int layer_id, int start_frame) {
+  if (start_frame < 0) return false;
+  CachedStmt stmt(db, "UPDATE layers SET sort_order = ? WHERE id = ?");
+  if (!stmt) return false;
+  stmt.bind(1, start_frame);
+  stmt.bind(2, layer_id);
+  return stmt.exec();
+}
+
+bool update_layer_span(sqlite3* db, int layer_id, int frame_span) {
+  if (frame_span < 1) return false;
+  CachedStmt stmt(db, "UPDATE layers SET frame_span = ? WHERE id = ?");
+  if (!stmt) return false;
+  stmt.bind(1, frame_span);
+  stmt.bind(2, layer_id);
+  return stmt.exec();
+}
+
+bool update_layer_extent(sqlite3* db, int layer_id, int start_frame, int frame_span) {
+  if (start_frame < 0 || frame_span < 1) return false;
+  CachedStmt stmt(db, "UPDATE layers SET sort_order = ?, frame_span = ? WHERE id = ?");
+  if (!stmt) return false;
+  stmt.bind(1, start_frame);
+  stmt.bind(2, frame_span);
+  stmt.bind(3, layer_id);
+  return stmt.exec();
+}
+
+bool delete_layer(sqlite3* db, int layer_id) {
+  CachedStmt stmt(db, "DELETE FROM layers WHERE id = ?");
+  if (!stmt) return false;
+  stmt.bind(1, layer_id);
+  return stmt.exec();
+}
+
+SceneFrameIndex build_scene_frame_index(sqlite3* db, int scene_id) {
+  return build_scene_frame_index(scene_id, 0, list_layers(db, scene_id));
+}
+
+SceneFrameIndex build_scene_frame_index(int scene_id, uint64_t revision, std::vector<LayerRow> layers) {
+  SceneFrameIndex idx;
+  idx.scene_id = scene_id;
+  idx.revision = revision;
+  idx.layers = std::move(layers);
+  // Sweep the frames where some layer starts or ends; the active set between two of them is one segment.
+  std::vector<std::pair<int, int>> events;  // (frame, +(index + 1) for a start or -(index + 1) for an end)
+  for (size_t i = 0; i < idx.layers.size(); i++) {
+    const LayerRow& L = idx.layers[i];
+    const int begin = std::max(0, L.start_frame);
+    const int end = L.start_frame + L.frame_span;
+    if (end <= begin) continue;
+    events.emplace_back(begin, static_cast<int>(i) + 1);
+    events.emplace_back(end, -static_cast<int>(i) - 1);
+  }
+  std::sort(events.begin(), events.end());
+  std::set<int> active;
+  int frame = 0;
+  for (size_t e = 0; e < events.size();) {
+    const int at = events[e].first;
+    if (at > frame) {
+      idx.segments.push_back(FrameSegment{frame, at - frame, std::vector<int>(active.begin(), active.end())});
+      frame = at;
+    }
+    for (; e < events.size() && events[e].first == at; e++) {
+      if (events[e].second > 0)
+        active.insert(events[e].second - 1);
+      else
+        active.erase(-events[e].second - 1);
+    }
+  }
+  idx.frame_segment.resize(frame);
+  for (size_t i = 0; i < idx.segments.size(); i++) {
+    const FrameSegment& seg = idx.segments[i];
+    std::fill_n(idx.frame_segment.begin() + seg.first_frame, seg.frame_count, static_cast<int>(i));
+  }
+  return idx;
+}
+
+void SceneFrameIndex::layers_in_range(int first_frame, int end_frame, std::vector<int>* out) const {
+  out->clear();
+  first_frame = std::max(first_frame, 0);
+  end_frame = std::min(end_frame, frame_count());
+  if (first_frame >= end_frame) return;
+  for (int s = frame_segment[first_frame]; s <= frame_segment[end_frame - 1]; s++)
+    out->insert(out->end(), segments[s].layers.begin(), segments[s].layers.end());
+  std::sort(out->begin(), out->end());
+  out->erase(std::unique(out->begin(), out->end()), out->end());
+}
+
+bool is_image_extension(const std::string& path) {
+  std::string ext = fs::path(path).extension().string();
+  std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+  return ext == ".png" || ext == ".jpg" || ext == ".jpeg" || ext == ".gif" ||
+         ext == ".bmp" || ext == ".webp" || ext == ".tga";
+}
+
+int add_media_rows(sqlite3* db, const std::vector<MediaRow>& rows) {
+  if (!db) return -1;
+  if (rows.empty()) return 0;
+  if (!run_sql(db, "BEGIN IMMEDIATE")) return -1;
+  int added = 0;
+  for (const MediaRow& m : rows) {
+    CachedStmt stmt(db,
+                    "INSERT INTO media(path, name, hash, size, width, height, channels, mtime) "
+                    "SELECT ?1, ?2, ?3, ?4, ?5, ?6, ?7, ?8 WHERE NOT EXISTS (SELECT 1 FROM media WHERE hash = ?3 AND path = ?1)");
+    if (!stmt) {
+      run_sql(db, "ROLLBACK");
+      return -1;
+    }
+    stmt.bind(1, m.path);
+    stmt.bind(2, m.name);
+    stmt.bind(3, m.hash);
+    stmt.bind(4, m.size);
+    stmt.bind(5, m.width);
+    stmt.bind(6, m.height);
+    stmt.bind(7, m.channels);
+    stmt.bind(8, m.mtime);
+    if (!stmt.exec()) {
+      run_sql(db, "ROLLBACK");
+      return -1;
+    }
+    if (sqlite3_changes(db) > 0) {
+      added++;
+      continue;
+    }
+    CachedStmt relist(db, "UPDATE media SET listed = 1 WHERE hash = ? AND path = ? AND listed = 0");
+    if (!relist) {
+      run_sql(db, "ROLLBACK");
+      return -1;
+    }
+    relist.bind(1, m.hash);
+    relist.bind(2, m.path);
+    if (!relist.exec()) {
+      run_sql(db, "ROLLBACK");
+      return -1;
+    }
+    added += sqlite3_changes(db);
+  }
+  return run_sql(db, "COMMIT") ? added : -1;
+}
+
+std::vector<MediaRow> list_media(sqlite3* db) {
+  std::vector<MediaRow> out;
+  CachedStmt stmt(db,
+                  "SELECT id, path, name, COALESCE(hash, ''), COALESCE(size, 0), COALESCE(width, 0), COALESCE(height, 0), "
+                  "COALESCE(channels, 0), COALESCE(mtime, 0), listed FROM media ORDER BY id");
+  if (!stmt) return out;
+  while (stmt.step_row()) {
+    MediaRow m;
+    m.id = stmt.column_int(0);
+    m.path = stmt.column_text(1);
+    m.name = stmt.column_text(2);
+    if (m.name.empty()) m.name = fs::path(m.path).filename().string();
+    m.hash = stmt.column_text(3);
+    m.size = stmt.column_int64(4);
+    m.width = stmt.column_int(5);
+    m.height = stmt.column_int(6);
+    m.channels = stmt.column_int(7);
+    m.mtime = stmt.column_int64(8);
+    m.listed = stmt.column_int(9) != 0;
+    out.push_back(std::move(m));
+  }
+  return out;
+}
+
+MediaIndex index_media(const std::vector<MediaRow>& media) {
+  MediaIndex index;
+  index.reserve(media.size());
+  for (const MediaRow& m : media) index[m.id] = &m;
+  return index;
+}
+
+bool delete_media(sqlite3* db, int media_id) {
+  CachedStmt del(db, "DELETE FROM media WHERE id = ?1 AND NOT EXISTS (SELECT 1 FROM layers WHERE media_id = ?1)");
+  CachedStmt unlist(db, "UPDATE media SET listed = 0 WHERE id = ?");
+  if (!del || !unlist) return false;
+  del.bind(1, media_id);
+  if (!del.exec()) return false;
+  if (sqlite3_changes(db) > 0) return true;
+  unlist.bind(1, media_id);
+  return unlist.exec() && sqlite3_changes(db) > 0;
+}
+
+bool update_media_metadata(sqlite3* db, const std::vector<MediaRow>& rows) {
+  if (!db) return false;
+  if (rows.empty()) return true;
+  if (!run_sql(db, "BEGIN IMMEDIATE")) return false;
+  for (const MediaRow& m : rows) {
+    CachedStmt stmt(db, "UPDATE media SET hash = ?, size = ?, width = ?, height = ?, channels = ?, mtime = ? WHERE id = ?");
+    if (!stmt) {
+      run_sql(db, "ROLLBACK");
+      return false;
+    }
+    stmt.bind(1, m.hash);
+    stmt.bind(2, m.size);
+    stmt.bind(3, m.width);
+    stmt.bind(4, m.height);
+    stmt.bind(5, m.channels);
+    stmt.bind(6, m.mtime);
+    stmt.bind(7, m.id);
+    if (!stmt.exec()) {
+      run_sql(db, "ROLLBACK");
+      return false;
+    }
+  }
+  return run_sql(db, "COMMIT");
+}
+
+bool rename_media(sqlite3* db, int media_id, const std::string& new_name) {
+  if (!db || new_name.empty())
+    return false;
+  CachedStmt stmt(db, "UPDATE media SET name = ? WHERE id = ?");
+  if (!stmt) return false;
+  stmt.bind(1, new_name);
+  stmt.bind(2, media_id);
+  return stmt.exec() && sqlite3_changes(db) > 0;
+}
+
+bool record_project(sqlite3* db, const std::string& name, const std::string& path) {
+  CachedStmt stmt(db, "INSERT INTO projects(name, path) VALUES(?, ?)");
+  if (!stmt) return false;
+  stmt.bind(1, name);
+  stmt.bind(2, path);
+  return stmt.exec();
+}
@@ -0,0 +1,156 @@
+#pragma once
+#include <sqlite3.h>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "resample.h"
+
+// Project database (project.db) schema and data-access helpers. No UI or GL dependencies, so the
+// renderer and command-line tools can link it on headless machines.
+
+// Helpers keep one prepared statement per query and connection, reset after each use. close_db finalizes
+// them before closing; use it (or SqliteDb) instead of sqlite3_close for any connection passed to them.
+void close_db(sqlite3* db);
+
+struct SqliteDeleter {
+  void operator()(sqlite3* p) const {
+    if (p) close_db(p);
+  }
+};
+using SqliteDb = std::unique_ptr<sqlite3, SqliteDeleter>;
+
+struct MovieConfig {
+  double duration_sec = 10.;
+  double frame_rate = 24.;
+  int width = 1920;
+  int height = 1080;
+  ScaleMode scale_mode = ScaleMode::Fit;
+
+  bool operator==(const MovieConfig&) const = default;
+};
+
+struct SceneRow {
+  int id;
+  int sort_order;
+  std::string name;
+};
+
+struct LayerRow {
+  int id;
+  int media_id;  // media row of the image shown
+  int start_frame;
+  int frame_span;
+};
+
+struct MediaRow {
+  int id = 0;
+  std::string path;  // relative to the project root
+  std::string name;  // shown in the UI; the imported file's name until renamed
+  std::string hash;  // content_hash_hex of the file, empty for media imported before content addressing
+  int64_t size = 0;  // bytes
+  // From the image header; 0 when unknown or the file is not a readable image.
+  int width = 0;
+  int height = 0;
+  int channels = 0;
+  int64_t mtime = 0;  // file's last_write_time ticks when the fields above were read; 0 if never
+  // False once removed from the media library while layers still show it; such rows stay for the layers.
+  bool listed = true;
+};
+
+// Media rows by id, pointing into the vector they were indexed from.
+using MediaIndex = std::unordered_map<int, const MediaRow*>;
+MediaIndex index_media(const std::vector<MediaRow>& media);
+
+// Consecutive frames of a scene that show the same layers.
+struct FrameSegment {
+  int first_frame = 0;
+  int frame_count = 0;
+  std::vector<int> layers;  // indices into SceneFrameIndex::layers, bottom to top; empty for a blank stretch
+};
+
+// Frame -> layers lookup table for one scene, built once from list_layers. Layers that overlap are
+// composited in list order (sort_order, then id), so the one listed last is on top, matching playback
+// and export. Segments cover every frame from 0 to frame_count() in order.
+struct SceneFrameIndex {
+  int scene_id = 0;
+  uint64_t revision = 0;  // ProjectModel::revision() when built by the model, 0 otherwise
+  std::vector<LayerRow> layers;
+  std::vector<FrameSegment> segments;
+  std::vector<int> frame_segment;  // index into segments per frame
+
+  int frame_count() const { return static_cast<int>(frame_segment.size()); }
+  const FrameSegment* segment_at(int frame) const {
+    if (frame < 0 || frame >= frame_count()) return nullptr;
+    return &segments[frame_segment[frame]];
+  }
+  // Topmost layer on a frame, nullptr where the scene shows nothing.
+  const LayerRow* layer_at(int frame) const {
+    const FrameSegment* seg = segment_at(frame);
+    if (!seg || seg->layers.empty()) return nullptr;
+    return &layers[seg->layers.back()];
+  }
+  // Indices of the layers shown anywhere in frames [first_frame, end_frame), ascending (bottom to top).
+  // Cost is proportional to the segments in the range, not to the scene.
+  void layers_in_range(int first_frame, int end_frame, std::vector<int>* out) const;
+  // Media ids of a segment's layers, bottom to top.
+  std::vector<int> media_ids(const FrameSegment& seg) const {
+    std::vector<int> ids;
+    ids.reserve(seg.layers.size());
+    for (int i : seg.layers) ids.push_back(layers[i].media_id);
+    return ids;
+  }
+};
+
+// Runs one or more SQL statements, returns false on any error.
+bool run_sql(sqlite3* db, const char* sql);
+// Busy timeout, WAL journaling and synchronous=NORMAL. Called by init_schema; call it directly on
+// connections that skip init_schema.
+void configure_connection(sqlite3* db);
+// Upgrades the schema to the current version (tracked in PRAGMA user_version), running only the missing
+// steps. Fails for files written by a newer version.
+bool init_schema(sqlite3* db);
+// Adds the row describing the project to the projects table.
+bool record_project(sqlite3* db, const std::string& name, const std::string& path);
+
+MovieConfig get_movie_config(sqlite3* db);
+bool set_movie_config(sqlite3* db, const MovieConfig& c);
+
+std::vector<SceneRow> list_scenes(sqlite3* db);
+bool create_scene(sqlite3* db);
+bool rename_scene(sqlite3* db, int id, const std::string& name);
+bool delete_scene(sqlite3* db, int id);
+bool move_scene_up(sqlite3* db, int scene_id);
+bool move_scene_down(sqlite3* db, int scene_id);
+
+// Layers of a scene ordered by start frame (sort_order), then id.
+std::vector<LayerRow> list_layers(sqlite3* db, int scene_id);
+bool add_layer_at_frame(sqlite3* db, int scene_id, int frame_index, int media_id, int frame_span = 1);
+bool update_layer_start_frame(sqlite3* db, int layer_id, int start_frame);
+bool update_layer_span(sqlite3* db, int layer_id, int frame_span);
+// Start frame and span in one statement, i.e. one transaction (used when a drag or resize ends).
+bool update_layer_extent(sqlite3* db, int layer_id, int start_frame, int frame_span);
+bool delete_layer(sqlite3* db, int layer_id);
+
+// Index of a scene as stored now, with revision 0 (export and tools build it once and never compare).
+SceneFrameIndex build_scene_frame_index(sqlite3* db, int scene_id);
+// Same, from layers already listed in list_layers order, stamped with the caller's revision (ProjectModel
+// uses its own, which playback compares to notice edits).
+SceneFrameIndex build_scene_frame_index(int scene_id, uint64_t revision, std::vector<LayerRow> layers);
+
+bool is_image_extension(const std::string& path);
+
+// Records files already stored under media/ (see store_media_file) in one transaction, skipping any already
+// in the table with the same hash and path (an unlisted one is listed again and counts as added). A row
+// whose file was edited in place may still carry the old hash until revalidated, so the path must match too.
+// Returns the number of rows added, -1 on error.
+int add_media_rows(sqlite3* db, const std::vector<MediaRow>& rows);
+// Media in import order, unlisted rows included.
+std::vector<MediaRow> list_media(sqlite3* db);
+// Removes media from the library: the row is deleted, or only unlisted while layers still use it.
+bool delete_media(sqlite3* db, int media_id);
+// Writes the file metadata (hash, size, dimensions, channels, mtime) of rows by id, in one transaction.
+bool update_media_metadata(sqlite3* db, const std::vector<MediaRow>& rows);
+// Changes the name shown for a media file; one row, the stored file and the layers using it are untouched.
+bool rename_media(sqlite3* db, int media_id, const std::string& new_name);
@@ -0,0 +1,206 @@
+#include "project_model.h"
+#include <algorithm>
+
+void ProjectModel::load(sqlite3* db) {
+  db_ = db;
+  config_ = get_movie_config(db);
+  scenes_ = list_scenes(db);
+  set_media(list_media(db));
+  layers_.clear();
+  revision_++;
+}
+
+void ProjectModel::reset() {
+  db_ = nullptr;
+  config_ = MovieConfig();
+  scenes_.clear();
+  set_media({});
+  layers_.clear();
+  revision_++;
+}
+
+bool ProjectModel::set_config(const MovieConfig& c) {
+  if (!::set_movie_config(db_, c)) return false;
+  config_ = c;
+  changed();
+  return true;
+}
+
+bool ProjectModel::create_scene() {
+  if (!::create_scene(db_)) return false;
+  scenes_ = list_scenes(db_);
+  changed();
+  return true;
+}
+
+bool ProjectModel::rename_scene(int id, const std::string& name) {
+  if (!::rename_scene(db_, id, name)) return false;
+  for (SceneRow& s : scenes_)
+    if (s.id == id) s.name = name;
+  changed();
+  return true;
+}
+
+bool ProjectModel::delete_scene(int id) {
+  if (!::delete_scene(db_, id)) return false;
+  scenes_.erase(std::remove_if(scenes_.begin(), scenes_.end(), [&](const SceneRow& s) { return s.id == id; }), scenes_.end());
+  layers_.erase(id);
+  changed();
+  return true;
+}
+
+bool ProjectModel::move_scene_up(int scene_id) {
+  if (!::move_scene_up(db_, scene_id)) return false;
+  scenes_ = list_scenes(db_);
+  changed();
+  return true;
+}
+
+bool ProjectModel::move_scene_down(int scene_id) {
+  if (!::move_scene_down(db_, scene_id)) return false;
+  scenes_ = list_scenes(db_);
+  changed();
+  return true;
+}
+
+ProjectModel::SceneLayers& ProjectModel::scene_layers(int scene_id) {
+  auto it = layers_.find(scene_id);
+  if (it == layers_.end()) {
+    it = layers_.emplace(scene_id, SceneLayers()).first;
+    it->second.layers = list_layers(db_, scene_id);
+  }
+  SceneLayers& sl = it->second;
+  if (sl.needs_reload) {
+    sl.layers = list_layers(db_, scene_id);
+    sl.needs_reload = false;
+    sl.needs_sort = false;
+  }
+  if (sl.needs_sort) {
+    std::sort(sl.layers.begin(), sl.layers.end(), [](const LayerRow& a, const LayerRow& b) {
+      return a.start_frame != b.start_frame ? a.start_frame < b.start_frame : a.id < b.id;
+    });
+    sl.needs_sort = false;
+  }
+  return sl;
+}
+
+const std::vector<LayerRow>& ProjectModel::layers(int scene_id) {
+  return scene_layers(scene_id).layers;
+}
+
+const SceneFrameIndex& ProjectModel::frame_index(int scene_id) {
+  SceneLayers& sl = scene_layers(scene_id);
+  if (!sl.index_valid) {
+    sl.index = build_scene_frame_index(scene_id, revision_, sl.layers);
+    sl.index_valid = true;
+  }
+  return sl.index;
+}
+
+LayerRow* ProjectModel::find_layer(int layer_id, SceneLayers** out_scene) {
+  for (auto& p : layers_) {
+    for (LayerRow& L : p.second.layers) {
+      if (L.id == layer_id) {
+        *out_scene = &p.second;
+        return &L;
+      }
+    }
+  }
+  return nullptr;
+}
+
+bool ProjectModel::add_layer_at_frame(int scene_id, int frame_index, int media_id, int frame_span) {
+  if (!::add_layer_at_frame(db_, scene_id, frame_index, media_id, frame_span)) return false;
+  auto it = layers_.find(scene_id);
+  if (it != layers_.end()) {
+    it->second.needs_reload = true;
+    it->second.index_valid = false;
+  }
+  changed();
+  return true;
+}
+
+bool ProjectModel::update_layer_start_frame(int layer_id, int start_frame) {
+  if (!::update_layer_start_frame(db_, layer_id, start_frame)) return false;
+  SceneLayers* sl = nullptr;
+  if (LayerRow* L = find_layer(layer_id, &sl)) {
+    L->start_frame = start_frame;
+    sl->needs_sort = true;
+    sl->index_valid = false;
+  }
+  changed();
+  return true;
+}
+
+bool ProjectModel::update_layer_span(int layer_id, int frame_span) {
+  if (!::update_layer_span(db_, layer_id, frame_span)) return false;
+  SceneLayers* sl = nullptr;
+  if (LayerRow* L = find_layer(layer_id, &sl)) {
+    L->frame_span = frame_span;
+    sl->index_valid = false;
+  }
+  changed();
+  return true;
+}
+
+bool ProjectModel::update_layer_extent(int layer_id, int start_frame, int frame_span) {
+  if (!::update_layer_extent(db_, layer_id, start_frame, frame_span)) return false;
+  SceneLayers* sl = nullptr;
+  if (LayerRow* L = find_layer(layer_id, &sl)) {
+    L->start_frame = start_frame;
+    L->frame_span = frame_span;
+    sl->needs_sort = true;
+    sl->index_valid = false;
+  }
+  changed();
+  return true;
+}
+
+bool ProjectModel::delete_layer(int layer_id) {
+  if (!::delete_layer(db_, layer_id)) return false;
+  SceneLayers* sl = nullptr;
+  if (find_layer(layer_id, &sl)) {
+    sl->needs_reload = true;
+    sl->index_valid = false;
+  }
+  changed();
+  return true;
+}
+
+void ProjectModel::reload_media() {
+  set_media(list_media(db_));
+  changed();
+}
+
+int ProjectModel::add_media_rows(const std::vector<MediaRow>& rows) {
+  const int added = ::add_media_rows(db_, rows);
+  if (added <= 0) return added;
+  set_media(list_media(db_));
+  changed();
+  return added;
+}
+
+bool ProjectModel::delete_media(int media_id) {
+  if (!::delete_media(db_, media_id)) return false;
+  set_media(list_media(db_));
+  changed();
+  return true;
+}
+
+bool ProjectModel::rename_media(int media_id, const std::string& new_name) {
+  if (!::rename_media(db_, media_id, new_name)) return false;
+  for (std::vector<MediaRow>* rows : {&media_, &unlisted_media_})
+    for (MediaRow& m : *rows)
+      if (m.id == media_id) m.name = new_name;
+  changed();
+  return true;
+}
+
+void ProjectModel::set_media(std::vector<MediaRow> media) {
+  media_.clear();
+  unlisted_media_.clear();
+  for (MediaRow& m : media)
+    (m.listed ? media_ : unlisted_media_).push_back(std::move(m));
+  media_by_id_ = index_media(media_);
+  for (const MediaRow& m : unlisted_media_) media_by_id_[m.id] = &m;
+}
@@ -0,0 +1,83 @@
+#pragma once
+#include <sqlite3.h>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+#include "project_db.h"
+
+// In-memory copy of an open project for the editor, so drawing a frame reads plain structs instead of
+// querying SQLite. Every mutation writes through the project_db helper of the same name, updates (or
+// reloads) only the part of the cache it touched and bumps revision(). The model does not own the
+// connection; changes made through other connections are not seen until load() is called again.
+class ProjectModel {
+ public:
+  // Reads config, scenes and media. Layers are read per scene on first use.
+  void load(sqlite3* db);
+  void reset();
+
+  sqlite3* db() const { return db_; }
+  // Incremented after every successful mutation.
+  uint64_t revision() const { return revision_; }
+
+  const MovieConfig& config() const { return config_; }
+  bool set_config(const MovieConfig& c);
+
+  const std::vector<SceneRow>& scenes() const { return scenes_; }
+  bool create_scene();
+  bool rename_scene(int id, const std::string& name);
+  bool delete_scene(int id);
+  bool move_scene_up(int scene_id);
+  bool move_scene_down(int scene_id);
+
+  // Layers in list_layers order. Layer edits never reallocate or reorder the returned vector (moves and
+  // resizes update rows in place; the order and added/deleted rows catch up on the next call), so the UI
+  // can keep iterating it while editing.
+  const std::vector<LayerRow>& layers(int scene_id);
+  const SceneFrameIndex& frame_index(int scene_id);
+  bool add_layer_at_frame(int scene_id, int frame_index, int media_id, int frame_span = 1);
+  bool update_layer_start_frame(int layer_id, int start_frame);
+  bool update_layer_span(int layer_id, int frame_span);
+  bool update_layer_extent(int layer_id, int start_frame, int frame_span);
+  bool delete_layer(int layer_id);
+
+  // The media library (listed rows) in import order.
+  const std::vector<MediaRow>& media() const { return media_; }
+  // Every media row by id, unlisted ones included, for resolving LayerRow::media_id.
+  const MediaIndex& media_index() const { return media_by_id_; }
+  // nullptr for ids not in the media table.
+  const MediaRow* find_media(int media_id) const {
+    auto it = media_by_id_.find(media_id);
+    return it == media_by_id_.end() ? nullptr : it->second;
+  }
+  // Rereads the media table after another connection changed it (see revalidate_media).
+  void reload_media();
+  // Records a finished import (see add_media_rows). Returns the number of rows added, -1 on error.
+  int add_media_rows(const std::vector<MediaRow>& rows);
+  bool delete_media(int media_id);
+  bool rename_media(int media_id, const std::string& new_name);
+
+ private:
+  struct SceneLayers {
+    std::vector<LayerRow> layers;
+    bool needs_sort = false;
+    bool needs_reload = false;
+    bool index_valid = false;
+    SceneFrameIndex index;
+  };
+
+  SceneLayers& scene_layers(int scene_id);
+  // Finds the cached row of a layer in any loaded scene; nullptr if its scene was never loaded.
+  LayerRow* find_layer(int layer_id, SceneLayers** out_scene);
+  void changed() { revision_++; }
+  void set_media(std::vector<MediaRow> media);
+
+  sqlite3* db_ = nullptr;
+  uint64_t revision_ = 0;
+  MovieConfig config_;
+  std::vector<SceneRow> scenes_;
+  std::vector<MediaRow> media_;           // listed
+  std::vector<MediaRow> unlisted_media_;  // kept for the layers that still show them
+  MediaIndex media_by_id_;                // into media_ and unlisted_media_
+  std::map<int, SceneLayers> layers_;
+};
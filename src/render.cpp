@@ -0,0 +1,508 @@
+#include "render.h"
+#include "bounded_queue.h"
+#include "content_hash.h"
+#include "ffmpeg_pipe.h"
+#include "media_import.h"
+#include "stbi_image_ptr.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <filesystem>
+#include <future>
+#include <memory>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+// Upper bound on memory held by frames travelling through the render pipeline.
+constexpr size_t kRenderPipelineBudgetBytes = size_t(1) << 30;
+
+int render_thread_count() {
+  unsigned n = std::thread::hardware_concurrency();
+  return n > 0 ? static_cast<int>(n) : 2;
+}
+
+using Clock = std::chrono::steady_clock;
+
+int64_t elapsed_ns(Clock::time_point since) {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - since).count();
+}
+
+// Render cache chunking, in frames and runs. A chunk ends after a run whose key hash is a multiple of
+// kChunkBoundaryRuns, so boundaries depend on nearby content only and an edit moves at most the boundaries
+// around it; the frame limits keep chunks from being tiny (an ffmpeg start each) or unbounded.
+constexpr int kMinChunkFrames = 96;
+constexpr int kMaxChunkFrames = 720;
+constexpr uint64_t kChunkBoundaryRuns = 16;
+// Bump when the encoder settings or the compositing output change, so old chunks are not reused.
+constexpr uint32_t kRenderCacheVersion = 1;
+
+// Consecutive output frames that show the same layers (a held picture); decoded and composited once.
+struct RenderRun {
+  std::vector<std::string> sources;  // absolute image paths, bottom to top; empty for a blank frame
+  std::vector<std::string> hashes;   // content hash per source; empty where the file is missing or unhashed
+  int frame_count = 0;
+};
+
+// Consecutive runs encoded into one file, the unit of the render cache.
+struct RenderChunk {
+  int first_run = 0;
+  int end_run = 0;  // one past the last run
+  int frame_count = 0;
+  std::string key;   // hash of everything the chunk's frames depend on; empty when some source is unknown
+  std::string path;  // encoded file: <key>.mp4 in the cache, or a scratch file for chunks without a key
+  bool cached = false;    // path was already in the cache before this export
+  bool repeated = false;  // same key as an earlier chunk of this export, which writes path
+};
+
+void hash_value(ContentHasher* h, const std::string& s) {
+  const uint64_t n = s.size();
+  h->update(&n, sizeof(n));
+  h->update(s.data(), s.size());
+}
+
+template <typename T>
+void hash_value(ContentHasher* h, const T& v) {
+  h->update(&v, sizeof(v));
+}
+
+// Hashes a run's sources and length; false if a source has no known content.
+bool hash_run(const RenderRun& run, ContentHasher* h) {
+  hash_value(h, run.frame_count);
+  hash_value(h, static_cast<uint32_t>(run.hashes.size()));
+  for (const std::string& hash : run.hashes) {
+    if (hash.empty()) return false;
+    hash_value(h, hash);
+  }
+  return true;
+}
+
+// Splits runs [first, end) of one scene into chunks and keys them by the output settings, the scaling
+// backend and their runs. A FrameScaler's frames are only within kFrameScalerTolerance of composite_layers,
+// so chunks from the two are never spliced into one movie.
+void chunk_scene_runs(const std::vector<RenderRun>& runs, int first, int end, const MovieConfig& cfg, bool frame_scaler,
+                      std::vector<RenderChunk>* out) {
+  RenderChunk chunk;
+  chunk.first_run = first;
+  for (int r = first; r < end; r++) {
+    chunk.frame_count += runs[r].frame_count;
+    ContentHasher run_hash;
+    hash_run(runs[r], &run_hash);
+    const bool boundary = chunk.frame_count >= kMaxChunkFrames ||
+                          (chunk.frame_count >= kMinChunkFrames && run_hash.digest() % kChunkBoundaryRuns == 0);
+    if (!boundary && r + 1 < end) continue;
+    chunk.end_run = r + 1;
+    ContentHasher h;
+    hash_value(&h, kRenderCacheVersion);
+    hash_value(&h, cfg.width);
+    hash_value(&h, cfg.height);
+    hash_value(&h, static_cast<int>(cfg.scale_mode));
+    hash_value(&h, cfg.frame_rate);
+    hash_value(&h, frame_scaler);
+    bool known = true;
+    for (int i = chunk.first_run; known && i < chunk.end_run; i++)
+      known = hash_run(runs[i], &h);
+    if (known) chunk.key = content_hash_hex(h.digest());
+    out->push_back(std::move(chunk));
+    chunk = RenderChunk();
+    chunk.first_run = r + 1;
+  }
+}
+
+bool render_cache_enabled() {
+  const char* v = std::getenv("CHYA_RENDER_CACHE");
+  return !(v && std::strcmp(v, "0") == 0);
+}
+
+}  // namespace
+
+bool render_project_to_video(sqlite3* db, const std::string& project_root, const std::string& output_path, std::atomic<float>* progress, std::string* error, RenderStats* stats, FrameScaler* scaler) {
+  auto fail = [&](const std::string& msg) {
+    if (error) *error = msg;
+    return false;
+  };
+  if (!db || project_root.empty() || output_path.empty()) return fail("No project or output path");
+  const auto t_start = Clock::now();
+  MovieConfig cfg = get_movie_config(db);
+  std::vector<SceneRow> scenes = list_scenes(db);
+  if (scenes.empty()) return fail("The project has no scenes");
+  int total_frames = 0;
+  std::vector<SceneFrameIndex> scene_indices;
+  scene_indices.reserve(scenes.size());
+  for (const SceneRow& scene : scenes) {
+    scene_indices.push_back(build_scene_frame_index(db, scene.id));
+    total_frames += scene_indices.back().frame_count();
+  }
+  if (total_frames <= 0) return fail("The scenes have no frames");
+  const int out_w = cfg.width;
+  const int out_h = cfg.height;
+  const bool use_cache = render_cache_enabled();
+  const fs::path cache_dir = fs::path(project_root) / ".chya" / "render_cache";
+  if (use_cache) {
+    // Chunk keys are built from content hashes, so files edited since they were last checked are rehashed.
+    revalidate_media(db, project_root);
+    std::error_code ec;
+    fs::create_directories(cache_dir, ec);
+    if (ec) return fail("Could not create " + cache_dir.string());
+  }
+
+  const std::vector<MediaRow> media = list_media(db);
+  const MediaIndex media_by_id = index_media(media);
+  // Decoded size of each run's sources from the media table's header metadata, for budgeting without a decode.
+  size_t max_run_source_bytes = 0;
+
+  // A file missing now renders blank, so its stored hash must not match a chunk encoded while it existed.
+  std::unordered_map<int, bool> media_present;
+  auto content_hash_of = [&](const MediaRow& m) {
+    if (m.hash.empty()) return std::string();
+    auto it = media_present.find(m.id);
+    if (it == media_present.end()) {
+      std::error_code ec;
+      it = media_present.emplace(m.id, fs::is_regular_file(fs::path(project_root) / m.path, ec)).first;
+    }
+    return it->second ? m.hash : std::string();
+  };
+
+  // Resolve all source paths on this thread so workers never touch the db connection.
+  std::vector<RenderRun> runs;
+  std::vector<std::pair<int, int>> scene_runs;  // [first, end) run range of each scene
+  for (const SceneFrameIndex& idx : scene_indices) {
+    const int scene_first_run = static_cast<int>(runs.size());
+    std::vector<int> prev_ids;
+    for (size_t i = 0; i < idx.segments.size(); i++) {
+      const FrameSegment& seg = idx.segments[i];
+      std::vector<int> ids = idx.media_ids(seg);
+      if (i > 0 && ids == prev_ids) {
+        runs.back().frame_count += seg.frame_count;
+        continue;
+      }
+      RenderRun run;
+      run.frame_count = seg.frame_count;
+      size_t run_source_bytes = 0;
+      for (int id : ids) {
+        auto it = media_by_id.find(id);
+        if (it == media_by_id.end()) {
+          run.sources.push_back(std::string());  // fails to decode like a missing file
+          run.hashes.push_back(std::string());
+          continue;
+        }
+        run.sources.push_back((fs::path(project_root) / it->second->path).string());
+        run.hashes.push_back(use_cache ? content_hash_of(*it->second) : std::string());
+        run_source_bytes += static_cast<size_t>(it->second->width) * it->second->height * 4;
+      }
+      max_run_source_bytes = std::max(max_run_source_bytes, run_source_bytes);
+      runs.push_back(std::move(run));
+      prev_ids = std::move(ids);
+    }
+    scene_runs.emplace_back(scene_first_run, static_cast<int>(runs.size()));
+  }
+  const int total_runs = static_cast<int>(runs.size());
+
+  // Runs of the chunks not in the cache are rendered; the rest is spliced in from earlier exports. Planned
+  // for the backend asked for, and again for the CPU if the scaler then cannot start.
+  std::vector<RenderChunk> chunks;
+  std::vector<int> run_chunk(total_runs, 0);
+  std::vector<int> work;  // run indices to decode, scale and encode, in output order
+  int total_work = 0;
+  int reused_frames = 0;  // frames of cached and repeated chunks
+  auto plan_chunks = [&](bool frame_scaler) {
+    chunks.clear();
+    work.clear();
+    reused_frames = 0;
+    if (use_cache) {
+      // Chunks never span scenes, so editing one scene leaves the others' chunks as they were.
+      for (const auto& [first, end] : scene_runs) chunk_scene_runs(runs, first, end, cfg, frame_scaler, &chunks);
+    } else {
+      // One chunk encoded straight into the output.
+      RenderChunk all;
+      all.end_run = total_runs;
+      all.frame_count = total_frames;
+      all.path = output_path;
+      chunks.push_back(std::move(all));
+    }
+    std::unordered_set<std::string> keys_rendered;  // a chunk repeated within the movie is encoded once
+    for (size_t c = 0; c < chunks.size(); c++) {
+      RenderChunk& chunk = chunks[c];
+      if (use_cache) {
+        std::error_code ec;
+        if (!chunk.key.empty()) {
+          chunk.path = (cache_dir / (chunk.key + ".mp4")).string();
+          chunk.repeated = !keys_rendered.insert(chunk.key).second;
+          chunk.cached = !chunk.repeated && fs::is_regular_file(chunk.path, ec);
+        } else {
+          chunk.path = (cache_dir / ("uncached-" + std::to_string(c) + ".mp4")).string();
+        }
+      }
+      if (chunk.cached || chunk.repeated) {
+        reused_frames += chunk.frame_count;
+        continue;
+      }
+      for (int r = chunk.first_run; r < chunk.end_run; r++) {
+        run_chunk[r] = static_cast<int>(c);
+        work.push_back(r);
+      }
+    }
+    total_work = static_cast<int>(work.size());
+  };
+  plan_chunks(scaler != nullptr);
+  if (progress) progress->store(static_cast<float>(reused_frames) / static_cast<float>(total_frames));
+  const auto t_setup = Clock::now();
+  std::atomic<int64_t> decode_ns(0), scale_ns(0);
+  int64_t encode_ns = 0;
+
+  struct DecodedFrame {
+    int index = 0;
+    std::vector<StbiImage> images;  // one per source; null where decoding failed
+    std::vector<LayerImage> layers;
+  };
+  struct ScaledFrame {
+    int index = 0;
+    std::vector<unsigned char> pixels;
+  };
+
+  const int workers = render_thread_count();
+  const size_t frame_bytes = static_cast<size_t>(out_w) * out_h * 4;
+  // A frame in flight holds its decoded sources until scaled and the output frame after; sources without
+  // metadata (not yet revalidated) count as nothing.
+  const size_t in_flight_bytes = std::max<size_t>(frame_bytes + max_run_source_bytes, 1);
+  const int max_in_flight = static_cast<int>(std::clamp<size_t>(kRenderPipelineBudgetBytes / in_flight_bytes, 2, static_cast<size_t>(workers) * 2));
+  BoundedQueue<int> credits(max_in_flight);
+  BoundedQueue<int> jobs(workers);
+  BoundedQueue<DecodedFrame> decoded(workers);
+  BoundedQueue<ScaledFrame> scaled(max_in_flight);
+  auto close_all = [&]() {
+    credits.close();
+    jobs.close();
+    decoded.close();
+    scaled.close();
+  };
+
+  for (int i = 0; i < max_in_flight; i++) credits.push(0);
+  std::vector<std::thread> threads;
+  // GPU scaling: one thread owns the scaler. Blank runs skip it; the reorder ring below puts them back in order.
+  // It starts before the feeder so that a fallback to the CPU can still change which chunks are rendered.
+  std::promise<bool> scaler_started;
+  std::string scaler_error;
+  bool gpu_scaled = false;
+  if (scaler && total_work > 0) {
+    std::future<bool> started = scaler_started.get_future();
+    threads.emplace_back([&]() {
+      if (!scaler->begin(out_w, out_h, cfg.scale_mode)) {
+        scaler_started.set_value(false);
+        return;
+      }
+      scaler_started.set_value(true);
+      std::deque<int> in_flight;  // run indices submitted to the scaler, oldest first
+      auto receive_oldest = [&]() {
+        ScaledFrame sf;
+        sf.index = in_flight.front();
+        in_flight.pop_front();
+        sf.pixels.resize(frame_bytes);
+        const auto t0 = Clock::now();
+        const bool ok = scaler->receive(sf.pixels.data());
+        scale_ns += elapsed_ns(t0);
+        if (!ok) scaler_error = "GPU readback failed";
+        return ok && scaled.push(std::move(sf));
+      };
+      DecodedFrame d;
+      for (;;) {
+        // Keep frames in flight only while more are queued: the writer may be waiting for the oldest one.
+        const bool got = in_flight.empty() ? decoded.pop(d) : decoded.try_pop(d);
+        if (!got) {
+          if (in_flight.empty() || !receive_oldest()) break;
+          continue;
+        }
+        if (d.layers.empty()) {
+          ScaledFrame sf;
+          sf.index = d.index;
+          sf.pixels.assign(frame_bytes, 0);
+          if (!scaled.push(std::move(sf))) break;
+          continue;
+        }
+        if (static_cast<int>(in_flight.size()) >= scaler->depth() && !receive_oldest()) break;
+        const auto t0 = Clock::now();
+        const bool ok = scaler->submit(d.layers.data(), static_cast<int>(d.layers.size()));
+        scale_ns += elapsed_ns(t0);
+        d.layers.clear();
+        d.images.clear();
+        if (!ok) {
+          scaler_error = "GPU scaling failed";
+          break;
+        }
+        in_flight.push_back(d.index);
+      }
+      scaler->end();
+      if (!scaler_error.empty()) close_all();
+    });
+    gpu_scaled = started.get();
+    if (!gpu_scaled) plan_chunks(false);
+  }
+  threads.emplace_back([&]() {
+    int token = 0;
+    for (int i = 0; i < total_work; i++)
+      if (!credits.pop(token) || !jobs.push(i)) break;
+    jobs.close();
+  });
+  for (int t = 0; t < workers; t++) {
+    threads.emplace_back([&]() {
+      int i = 0;
+      while (jobs.pop(i)) {
+        DecodedFrame d;
+        d.index = i;
+        const auto t0 = Clock::now();
+        for (const std::string& source : runs[work[i]].sources) {
+          LayerImage L;
+          int ic = 0;
+          StbiImage img(stbi_load(source.c_str(), &L.w, &L.h, &ic, 4));
+          if (!img) continue;
+          L.pixels = img.get();
+          d.images.push_back(std::move(img));
+          d.layers.push_back(L);
+        }
+        decode_ns += elapsed_ns(t0);
+        if (!decoded.push(std::move(d))) break;
+      }
+    });
+  }
+  for (int t = 0; !gpu_scaled && t < std::max(1, workers / 2); t++) {
+    threads.emplace_back([&]() {
+      DecodedFrame d;
+      std::vector<unsigned char> scratch;
+      while (decoded.pop(d)) {
+        ScaledFrame sf;
+        sf.index = d.index;
+        sf.pixels.resize(frame_bytes);
+        const auto t0 = Clock::now();
+        composite_layers(d.layers.data(), static_cast<int>(d.layers.size()), sf.pixels.data(), out_w, out_h, cfg.scale_mode, &scratch);
+        scale_ns += elapsed_ns(t0);
+        d.layers.clear();
+        d.images.clear();
+        if (!scaled.push(std::move(sf))) break;
+      }
+    });
+  }
+
+  // Each chunk gets its own encoder, opened at its first run and finished after its last. A cached chunk is
+  // written to a temporary name and renamed when complete, so a cache entry is never a partial file.
+  FfmpegPipe encoder;
+  int open_chunk = -1;
+  std::string open_path;
+  std::string encode_error;
+  auto finish_chunk = [&]() {
+    const RenderChunk& chunk = chunks[open_chunk];
+    open_chunk = -1;
+    bool ok = encoder.finish();
+    if (!ok) encode_error = encoder.error();
+    std::error_code ec;
+    if (ok && open_path != chunk.path) {
+      fs::rename(open_path, chunk.path, ec);
+      if (ec) {
+        encode_error = "Could not write " + chunk.path;
+        ok = false;
+      }
+    }
+    if (!ok && open_path != output_path) fs::remove(open_path, ec);
+    return ok;
+  };
+
+  // Runs arrive out of order; the credit window guarantees index < committed + max_in_flight, so a ring of
+  // max_in_flight slots is enough to reorder them.
+  std::vector<std::vector<unsigned char>> pending(max_in_flight);
+  int committed = 0;
+  int frames_written = 0;
+  bool write_ok = true;
+  ScaledFrame sf;
+  while (write_ok && committed < total_work && scaled.pop(sf)) {
+    pending[sf.index % max_in_flight] = std::move(sf.pixels);
+    while (write_ok && committed < total_work && !pending[committed % max_in_flight].empty()) {
+      std::vector<unsigned char>& frame = pending[committed % max_in_flight];
+      const int r = work[committed];
+      const auto t0 = Clock::now();
+      if (open_chunk < 0) {
+        open_chunk = run_chunk[r];
+        const RenderChunk& chunk = chunks[open_chunk];
+        open_path = chunk.key.empty() ? chunk.path : (cache_dir / (chunk.key + ".part.mp4")).string();
+        if (!encoder.open(open_path, out_w, out_h, cfg.frame_rate)) {
+          encode_error = encoder.error();
+          open_chunk = -1;
+          write_ok = false;
+          break;
+        }
+      }
+      for (int k = 0; k < runs[r].frame_count; k++) {
+        if (!encoder.write_frame(frame.data())) {
+          write_ok = false;
+          break;
+        }
+        frames_written++;
+        if (progress) progress->store(static_cast<float>(reused_frames + frames_written) / static_cast<float>(total_frames));
+      }
+      if (write_ok && r + 1 == chunks[open_chunk].end_run) write_ok = finish_chunk();
+      encode_ns += elapsed_ns(t0);
+      if (!write_ok) break;
+      frame.clear();
+      frame.shrink_to_fit();
+      committed++;
+      credits.push(0);
+    }
+  }
+  close_all();
+  for (std::thread& t : threads) t.join();
+  const auto t_finish = Clock::now();
+  if (open_chunk >= 0) {
+    // Stopped part way through a chunk: its file is incomplete and must not enter the cache.
+    encoder.finish();
+    if (encode_error.empty()) encode_error = encoder.error();
+    std::error_code ec;
+    if (open_path != output_path) fs::remove(open_path, ec);
+  }
+  bool encoded = encode_error.empty() && committed == total_work;
+  if (encoded && use_cache) {
+    std::vector<std::string> parts;
+    std::unordered_set<std::string> keep;
+    for (const RenderChunk& chunk : chunks) {
+      parts.push_back(chunk.path);
+      if (!chunk.key.empty()) keep.insert(fs::path(chunk.path).filename().string());
+    }
+    encoded = concat_videos(parts, (cache_dir / "concat.txt").string(), output_path, &encode_error);
+    // The cache holds the chunks of the latest export only; scratch files and older chunks are dropped.
+    std::error_code ec;
+    std::vector<fs::path> stale;
+    for (const auto& e : fs::directory_iterator(cache_dir, ec))
+      if (!keep.count(e.path().filename().string())) stale.push_back(e.path());
+    for (const fs::path& path : stale) fs::remove(path, ec);
+  }
+  encode_ns += elapsed_ns(t_finish);
+  if (progress) progress->store(1.f);
+  if (stats) {
+    stats->frames = reused_frames + frames_written;
+    stats->rendered_runs = committed;
+    stats->chunks = static_cast<int>(chunks.size());
+    for (const RenderChunk& chunk : chunks) {
+      if (chunk.cached) {
+        stats->cached_chunks++;
+        stats->cached_frames += chunk.frame_count;
+      } else if (chunk.repeated) {
+        stats->repeated_chunks++;
+        stats->repeated_frames += chunk.frame_count;
+      }
+    }
+    stats->setup_sec = std::chrono::duration<double>(t_setup - t_start).count();
+    stats->decode_sec = decode_ns.load() * 1e-9;
+    stats->scale_sec = scale_ns.load() * 1e-9;
+    stats->encode_sec = encode_ns * 1e-9;
+    stats->total_sec = std::chrono::duration<double>(Clock::now() - t_start).count();
+    stats->gpu_scaled = gpu_scaled;
+  }
+  if (!scaler_error.empty()) return fail(scaler_error);
+  if (!encoded) return fail(encode_error.empty() ? std::string("Render stopped before all frames were written") : encode_error);
+  return true;
+}
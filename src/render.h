@@ -0,0 +1,64 @@
+#pragma once
+#include <sqlite3.h>
+#include <atomic>
+#include <string>
+#include "composite.h"
+#include "project_db.h"
+
+// Timings of one export. Stage times are summed over that stage's worker threads, so on a multi-core
+// machine decode_sec + scale_sec can exceed total_sec.
+struct RenderStats {
+  int frames = 0;          // frames written to the video
+  int rendered_runs = 0;   // runs of frames with the same layers decoded and composited, once each; runs in
+                           // chunks reused from the render cache are not counted
+  double setup_sec = 0.;   // reading the project and resolving frames to images
+  double decode_sec = 0.;
+  double scale_sec = 0.;
+  double encode_sec = 0.;  // writing frames into ffmpeg, waiting for it to finish and joining the chunks
+  double total_sec = 0.;
+  bool gpu_scaled = false; // scale_sec covers the FrameScaler, not the CPU resampler
+  int cached_frames = 0;   // frames spliced in from chunks an earlier export left in the render cache, neither
+                           // decoded nor encoded again
+  int chunks = 0;          // separately encoded pieces of the video
+  int cached_chunks = 0;
+  int repeated_chunks = 0; // chunks identical to an earlier chunk of the same video, encoded once and joined again
+  int repeated_frames = 0;
+};
+
+// A FrameScaler's frames may differ from composite_layers by this many levels per channel: the GPU filters
+// in float and blends in 8-bit fixed function. `chya --self-check` holds the GL scaler to it.
+constexpr int kFrameScalerTolerance = 3;
+
+// Alternative backend for the scale stage of render_project_to_video, e.g. on the GPU. All calls come from
+// one thread, begin() first. Frames are pipelined: submit() may return before the frame is scaled, and
+// receive() hands back the oldest submitted frame, so at most depth() frames are in flight. Output must
+// match composite_layers (same filters, placement and blending) within kFrameScalerTolerance.
+class FrameScaler {
+ public:
+  virtual ~FrameScaler() = default;
+  // False if the backend cannot run here; the export then scales on the CPU.
+  virtual bool begin(int out_w, int out_h, ScaleMode mode) = 0;
+  // Straight-alpha layer images, bottom to top, at least one. They are not modified. False if the frame
+  // cannot be scaled, e.g. a layer larger than the GPU's texture limit; the export then fails.
+  virtual bool submit(const LayerImage* layers, int count) = 0;
+  // Writes out_w * out_h * 4 bytes.
+  virtual bool receive(unsigned char* dst) = 0;
+  virtual int depth() const = 0;
+  virtual void end() = 0;
+};
+
+// Renders every scene in order and streams the frames as raw RGBA into an ffmpeg child process.
+// Overlapping layers are composited (composite_layers). Frames with the same layers are grouped into runs;
+// runs flow feeder -> decode -> scale through bounded queues, each stage running on its own worker pool,
+// and a window (credits) caps how many runs are in flight. Runs are written to ffmpeg strictly in output
+// order, each scaled buffer repeated frame_count times, so decoding overlaps encoding. progress goes from
+// 0 to 1; on failure *error (if given) describes what went wrong.
+// With a scaler whose begin() succeeds, one thread feeds it in place of the CPU scale workers.
+// Each scene is encoded as chunks of whole runs, cached in <project>/.chya/render_cache under a hash of the
+// output settings, whether a scaler is used and the content hashes and lengths of their runs, and joined into
+// output_path without re-encoding. A chunk already in the cache is not rendered again, so after an edit only
+// the chunks it touched are. The cache keeps the latest export's chunks; CHYA_RENDER_CACHE=0 encodes straight
+// into output_path instead.
+bool render_project_to_video(sqlite3* db, const std::string& project_root, const std::string& output_path,
+                             std::atomic<float>* progress, std::string* error = nullptr, RenderStats* stats = nullptr,
+                             FrameScaler* scaler = nullptr);
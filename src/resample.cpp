@@ -0,0 +1,296 @@
+#include "resample.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <utility>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64)
+#define CHYA_RESAMPLE_X86 1
+#include <immintrin.h>
+#endif
+#if defined(CHYA_RESAMPLE_X86) && (defined(__GNUC__) || defined(__clang__))
+#define CHYA_RESAMPLE_AVX2 1
+#endif
+
+namespace {
+
+constexpr int kCoefBits = 14;
+constexpr int kCoefOne = 1 << kCoefBits;
+
+// Source taps of one output sample as (index, weight) with weights summing to 1.
+// Area filter when shrinking (scale > 1), bilinear when growing; indices are clamped to the image.
+std::vector<std::pair<int, double>> filter_taps(int src_size, double src_off, double scale, int i) {
+  std::vector<std::pair<int, double>> taps;
+  auto add = [&](int j, double w) {
+    j = std::clamp(j, 0, src_size - 1);
+    if (!taps.empty() && taps.back().first == j)
+      taps.back().second += w;
+    else
+      taps.emplace_back(j, w);
+  };
+  if (scale > 1.) {
+    double lo = src_off + i * scale;
+    double hi = lo + scale;
+    for (int j = static_cast<int>(std::floor(lo)); j < hi; j++) {
+      double w = std::min(hi, j + 1.) - std::max(lo, static_cast<double>(j));
+      if (w > 0.) add(j, w / scale);
+    }
+  } else {
+    double center = src_off + (i + 0.5) * scale - 0.5;
+    int j0 = static_cast<int>(std::floor(center));
+    double f = center - j0;
+    add(j0, 1. - f);
+    if (f > 0.) add(j0 + 1, f);
+  }
+  return taps;
+}
+
+// Fixed-point coefficient table for one axis: output i reads src[first[i] .. first[i] + taps).
+struct AxisCoefs {
+  int taps = 1;
+  std::vector<int> first;
+  std::vector<int16_t> weights;  // taps entries per output, Q14
+};
+
+AxisCoefs build_axis(int src_size, double src_off, double src_len, int dst_len) {
+  AxisCoefs a;
+  const double scale = src_len / dst_len;
+  std::vector<std::vector<std::pair<int, double>>> all(dst_len);
+  for (int i = 0; i < dst_len; i++) {
+    all[i] = filter_taps(src_size, src_off, scale, i);
+    a.taps = std::max(a.taps, all[i].back().first - all[i].front().first + 1);
+  }
+  a.taps = std::min(a.taps, src_size);
+  a.first.resize(dst_len);
+  a.weights.assign(static_cast<size_t>(dst_len) * a.taps, 0);
+  for (int i = 0; i < dst_len; i++) {
+    int first = std::min(all[i].front().first, src_size - a.taps);
+    a.first[i] = first;
+    int16_t* w = &a.weights[static_cast<size_t>(i) * a.taps];
+    int sum = 0, largest = 0;
+    for (const auto& [j, wd] : all[i]) {
+      int k = j - first;
+      w[k] = static_cast<int16_t>(std::lround(wd * kCoefOne));
+      sum += w[k];
+      if (w[k] > w[largest]) largest = k;
+    }
+    w[largest] = static_cast<int16_t>(w[largest] + kCoefOne - sum);
+  }
+  return a;
+}
+
+inline unsigned char clamp_u8(int v) {
+  return static_cast<unsigned char>(v < 0 ? 0 : (v > 255 ? 255 : v));
+}
+
+#if !defined(CHYA_RESAMPLE_X86)
+void horizontal_scalar(const unsigned char* row, unsigned char* out, const AxisCoefs& ax, int dst_w) {
+  for (int x = 0; x < dst_w; x++) {
+    const unsigned char* p = row + static_cast<size_t>(ax.first[x]) * 4;
+    const int16_t* w = &ax.weights[static_cast<size_t>(x) * ax.taps];
+    int acc[4] = {1 << (kCoefBits - 1), 1 << (kCoefBits - 1), 1 << (kCoefBits - 1), 1 << (kCoefBits - 1)};
+    for (int k = 0; k < ax.taps; k++)
+      for (int c = 0; c < 4; c++) acc[c] += p[k * 4 + c] * w[k];
+    for (int c = 0; c < 4; c++) out[x * 4 + c] = clamp_u8(acc[c] >> kCoefBits);
+  }
+}
+#endif
+
+void vertical_scalar(const unsigned char* const* rows, const int16_t* w, int taps, unsigned char* out, int begin, int end) {
+  for (int i = begin; i < end; i++) {
+    int acc = 1 << (kCoefBits - 1);
+    for (int k = 0; k < taps; k++) acc += rows[k][i] * w[k];
+    out[i] = clamp_u8(acc >> kCoefBits);
+  }
+}
+
+#if defined(CHYA_RESAMPLE_X86)
+inline __m128i load_pixel(const unsigned char* p) {
+  int v;
+  std::memcpy(&v, p, 4);
+  return _mm_cvtsi32_si128(v);
+}
+
+inline __m128i weight_pair(int16_t w0, int16_t w1) {
+  return _mm_set1_epi32(static_cast<int>(static_cast<uint16_t>(w0)) | (static_cast<int>(w1) << 16));
+}
+
+// Two taps per madd: pixels k and k+1 interleaved as (r0 r1 g0 g1 b0 b1 a0 a1) against (w0 w1) pairs.
+void horizontal_sse2(const unsigned char* row, unsigned char* out, const AxisCoefs& ax, int dst_w) {
+  const __m128i zero = _mm_setzero_si128();
+  for (int x = 0; x < dst_w; x++) {
+    const unsigned char* p = row + static_cast<size_t>(ax.first[x]) * 4;
+    const int16_t* w = &ax.weights[static_cast<size_t>(x) * ax.taps];
+    __m128i acc = _mm_set1_epi32(1 << (kCoefBits - 1));
+    int k = 0;
+    for (; k + 1 < ax.taps; k += 2) {
+      __m128i px = _mm_unpacklo_epi8(_mm_unpacklo_epi8(load_pixel(p + k * 4), load_pixel(p + k * 4 + 4)), zero);
+      acc = _mm_add_epi32(acc, _mm_madd_epi16(px, weight_pair(w[k], w[k + 1])));
+    }
+    if (k < ax.taps) {
+      __m128i px = _mm_unpacklo_epi8(_mm_unpacklo_epi8(load_pixel(p + k * 4), zero), zero);
+      acc = _mm_add_epi32(acc, _mm_madd_epi16(px, weight_pair(w[k], 0)));
+    }
+    acc = _mm_srai_epi32(acc, kCoefBits);
+    acc = _mm_packus_epi16(_mm_packs_epi32(acc, acc), acc);
+    int v = _mm_cvtsi128_si32(acc);
+    std::memcpy(out + x * 4, &v, 4);
+  }
+}
+
+// 16 bytes per step; rows k and k+1 interleaved bytewise and multiplied against (w0 w1) pairs.
+void vertical_sse2(const unsigned char* const* rows, const int16_t* w, int taps, unsigned char* out, int begin, int end) {
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i round = _mm_set1_epi32(1 << (kCoefBits - 1));
+  int i = begin;
+  for (; i + 16 <= end; i += 16) {
+    __m128i s0 = round, s1 = round, s2 = round, s3 = round;
+    for (int k = 0; k < taps; k += 2) {
+      __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(rows[k] + i));
+      __m128i b = (k + 1 < taps) ? _mm_loadu_si128(reinterpret_cast<const __m128i*>(rows[k + 1] + i)) : zero;
+      __m128i wp = weight_pair(w[k], (k + 1 < taps) ? w[k + 1] : 0);
+      __m128i lo = _mm_unpacklo_epi8(a, b);
+      __m128i hi = _mm_unpackhi_epi8(a, b);
+      s0 = _mm_add_epi32(s0, _mm_madd_epi16(_mm_unpacklo_epi8(lo, zero), wp));
+      s1 = _mm_add_epi32(s1, _mm_madd_epi16(_mm_unpackhi_epi8(lo, zero), wp));
+      s2 = _mm_add_epi32(s2, _mm_madd_epi16(_mm_unpacklo_epi8(hi, zero), wp));
+      s3 = _mm_add_epi32(s3, _mm_madd_epi16(_mm_unpackhi_epi8(hi, zero), wp));
+    }
+    __m128i p01 = _mm_packs_epi32(_mm_srai_epi32(s0, kCoefBits), _mm_srai_epi32(s1, kCoefBits));
+    __m128i p23 = _mm_packs_epi32(_mm_srai_epi32(s2, kCoefBits), _mm_srai_epi32(s3, kCoefBits));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), _mm_packus_epi16(p01, p23));
+  }
+  vertical_scalar(rows, w, taps, out, i, end);
+}
+#endif
+
+#if defined(CHYA_RESAMPLE_AVX2)
+// Same as vertical_sse2 on 32 bytes per step. Unpack/pack work per 128-bit lane, which keeps byte order intact.
+__attribute__((target("avx2")))
+void vertical_avx2(const unsigned char* const* rows, const int16_t* w, int taps, unsigned char* out, int begin, int end) {
+  const __m256i zero = _mm256_setzero_si256();
+  const __m256i round = _mm256_set1_epi32(1 << (kCoefBits - 1));
+  int i = begin;
+  for (; i + 32 <= end; i += 32) {
+    __m256i s0 = round, s1 = round, s2 = round, s3 = round;
+    for (int k = 0; k < taps; k += 2) {
+      __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(rows[k] + i));
+      __m256i b = (k + 1 < taps) ? _mm256_loadu_si256(reinterpret_cast<const __m256i*>(rows[k + 1] + i)) : zero;
+      int16_t w1 = (k + 1 < taps) ? w[k + 1] : 0;
+      __m256i wp = _mm256_set1_epi32(static_cast<int>(static_cast<uint16_t>(w[k])) | (static_cast<int>(w1) << 16));
+      __m256i lo = _mm256_unpacklo_epi8(a, b);
+      __m256i hi = _mm256_unpackhi_epi8(a, b);
+      s0 = _mm256_add_epi32(s0, _mm256_madd_epi16(_mm256_unpacklo_epi8(lo, zero), wp));
+      s1 = _mm256_add_epi32(s1, _mm256_madd_epi16(_mm256_unpackhi_epi8(lo, zero), wp));
+      s2 = _mm256_add_epi32(s2, _mm256_madd_epi16(_mm256_unpacklo_epi8(hi, zero), wp));
+      s3 = _mm256_add_epi32(s3, _mm256_madd_epi16(_mm256_unpackhi_epi8(hi, zero), wp));
+    }
+    __m256i p01 = _mm256_packs_epi32(_mm256_srai_epi32(s0, kCoefBits), _mm256_srai_epi32(s1, kCoefBits));
+    __m256i p23 = _mm256_packs_epi32(_mm256_srai_epi32(s2, kCoefBits), _mm256_srai_epi32(s3, kCoefBits));
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), _mm256_packus_epi16(p01, p23));
+  }
+  vertical_sse2(rows, w, taps, out, i, end);
+}
+
+bool cpu_has_avx2() {
+  static const bool has = __builtin_cpu_supports("avx2");
+  return has;
+}
+#endif
+
+void horizontal_pass(const unsigned char* row, unsigned char* out, const AxisCoefs& ax, int dst_w) {
+#if defined(CHYA_RESAMPLE_X86)
+  horizontal_sse2(row, out, ax, dst_w);
+#else
+  horizontal_scalar(row, out, ax, dst_w);
+#endif
+}
+
+void vertical_pass(const unsigned char* const* rows, const int16_t* w, int taps, unsigned char* out, int len) {
+#if defined(CHYA_RESAMPLE_AVX2)
+  if (cpu_has_avx2()) {
+    vertical_avx2(rows, w, taps, out, 0, len);
+    return;
+  }
+#endif
+#if defined(CHYA_RESAMPLE_X86)
+  vertical_sse2(rows, w, taps, out, 0, len);
+#else
+  vertical_scalar(rows, w, taps, out, 0, len);
+#endif
+}
+
+}  // namespace
+
+ScaleRect compute_scale_rect(int src_w, int src_h, int dst_w, int dst_h, ScaleMode mode) {
+  ScaleRect r;
+  r.src_w = src_w;
+  r.src_h = src_h;
+  r.dst_w = dst_w;
+  r.dst_h = dst_h;
+  if (src_w <= 0 || src_h <= 0 || dst_w <= 0 || dst_h <= 0 || mode == ScaleMode::Stretch) return r;
+  const double sx = static_cast<double>(dst_w) / src_w;
+  const double sy = static_cast<double>(dst_h) / src_h;
+  if (mode == ScaleMode::Fit) {
+    const double s = std::min(sx, sy);
+    r.dst_w = std::clamp(static_cast<int>(std::lround(src_w * s)), 1, dst_w);
+    r.dst_h = std::clamp(static_cast<int>(std::lround(src_h * s)), 1, dst_h);
+    r.dst_x = (dst_w - r.dst_w) / 2;
+    r.dst_y = (dst_h - r.dst_h) / 2;
+  } else {
+    const double s = std::max(sx, sy);
+    r.src_w = std::min(static_cast<double>(src_w), dst_w / s);
+    r.src_h = std::min(static_cast<double>(src_h), dst_h / s);
+    r.src_x = (src_w - r.src_w) * 0.5;
+    r.src_y = (src_h - r.src_h) * 0.5;
+  }
+  return r;
+}
+
+void resample_rgba(const unsigned char* src, int src_w, int src_h, unsigned char* dst, int dst_w, int dst_h, ScaleMode mode) {
+  if (!dst || dst_w <= 0 || dst_h <= 0) return;
+  const size_t dst_stride = static_cast<size_t>(dst_w) * 4;
+  std::memset(dst, 0, dst_stride * dst_h);
+  if (!src || src_w <= 0 || src_h <= 0) return;
+  const ScaleRect r = compute_scale_rect(src_w, src_h, dst_w, dst_h, mode);
+  const AxisCoefs ax = build_axis(src_w, r.src_x, r.src_w, r.dst_w);
+  const AxisCoefs ay = build_axis(src_h, r.src_y, r.src_h, r.dst_h);
+
+  // Horizontal pass over just the source rows the vertical taps read.
+  const int row_begin = ay.first.front();
+  const int row_end = ay.first.back() + ay.taps;
+  const size_t tmp_stride = static_cast<size_t>(r.dst_w) * 4;
+  std::vector<unsigned char> tmp(tmp_stride * (row_end - row_begin));
+  for (int y = row_begin; y < row_end; y++)
+    horizontal_pass(src + static_cast<size_t>(y) * src_w * 4, tmp.data() + (y - row_begin) * tmp_stride, ax, r.dst_w);
+
+  std::vector<const unsigned char*> rows(ay.taps);
+  for (int y = 0; y < r.dst_h; y++) {
+    for (int k = 0; k < ay.taps; k++)
+      rows[k] = tmp.data() + (ay.first[y] + k - row_begin) * tmp_stride;
+    unsigned char* out = dst + (r.dst_y + y) * dst_stride + static_cast<size_t>(r.dst_x) * 4;
+    vertical_pass(rows.data(), &ay.weights[static_cast<size_t>(y) * ay.taps], ay.taps, out, static_cast<int>(tmp_stride));
+  }
+}
+
+void resample_rgba_reference(const unsigned char* src, int src_w, int src_h, unsigned char* dst, int dst_w, int dst_h, ScaleMode mode) {
+  if (!dst || dst_w <= 0 || dst_h <= 0) return;
+  std::memset(dst, 0, static_cast<size_t>(dst_w) * dst_h * 4);
+  if (!src || src_w <= 0 || src_h <= 0) return;
+  const ScaleRect r = compute_scale_rect(src_w, src_h, dst_w, dst_h, mode);
+  for (int y = 0; y < r.dst_h; y++) {
+    const auto ty = filter_taps(src_h, r.src_y, r.src_h / r.dst_h, y);
+    for (int x = 0; x < r.dst_w; x++) {
+      const auto tx = filter_taps(src_w, r.src_x, r.src_w / r.dst_w, x);
+      double acc[4] = {0., 0., 0., 0.};
+      for (const auto& [sy, wy] : ty)
+        for (const auto& [sx, wx] : tx)
+          for (int c = 0; c < 4; c++)
+            acc[c] += src[(static_cast<size_t>(sy) * src_w + sx) * 4 + c] * wy * wx;
+      unsigned char* out = dst + ((static_cast<size_t>(r.dst_y) + y) * dst_w + r.dst_x + x) * 4;
+      for (int c = 0; c < 4; c++) out[c] = clamp_u8(static_cast<int>(std::lround(acc[c])));
+    }
+  }
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+// How a source image is placed into an output frame of a different aspect ratio.
+enum class ScaleMode : int {
+  Fit = 0,      // whole image visible, remaining area left transparent black
+  Fill = 1,     // image covers the frame, overflow cropped around the centre
+  Stretch = 2,  // image stretched to the frame, aspect ratio ignored
+};
+
+// Source region (fractional pixels) and destination rectangle an image maps to for a given mode.
+struct ScaleRect {
+  double src_x = 0., src_y = 0., src_w = 0., src_h = 0.;
+  int dst_x = 0, dst_y = 0, dst_w = 0, dst_h = 0;
+};
+ScaleRect compute_scale_rect(int src_w, int src_h, int dst_w, int dst_h, ScaleMode mode);
+
+// Resamples an RGBA8 image into dst (dst_w * dst_h * 4 bytes, every byte written).
+// Axes that shrink use area (box) filtering, axes that grow use bilinear filtering. Per-row and per-column
+// coefficients are computed once per call; AVX2/SSE2 kernels are picked at runtime with a scalar fallback.
+void resample_rgba(const unsigned char* src, int src_w, int src_h, unsigned char* dst, int dst_w, int dst_h, ScaleMode mode);
+
+// resample_rgba stays within this many levels per channel of resample_rgba_reference (fixed-point
+// coefficients and rounding); `chya --self-check` holds it to that.
+constexpr int kResampleReferenceTolerance = 1;
+
+// Plain double-precision implementation of the same filters. Slow; the reference resample_rgba is checked
+// against.
+void resample_rgba_reference(const unsigned char* src, int src_w, int src_h, unsigned char* dst, int dst_w, int dst_h, ScaleMode mode);
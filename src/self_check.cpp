@@ -0,0 +1,127 @@
+#include "self_check.h"
+#include "composite.h"
+#include "render.h"
+#include "resample.h"
+#include <algorithm>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+namespace {
+
+constexpr unsigned kSeed = 20240601;
+
+const char* mode_name(ScaleMode mode) {
+  switch (mode) {
+    case ScaleMode::Fit: return "fit";
+    case ScaleMode::Fill: return "fill";
+    case ScaleMode::Stretch: return "stretch";
+  }
+  return "?";
+}
+
+std::vector<unsigned char> random_rgba(std::mt19937* rng, int w, int h) {
+  std::vector<unsigned char> px(static_cast<size_t>(w) * h * 4);
+  std::uniform_int_distribution<int> byte(0, 255);
+  for (unsigned char& v : px) v = static_cast<unsigned char>(byte(*rng));
+  return px;
+}
+
+// Largest per-channel difference between two buffers of the same size.
+int max_difference(const std::vector<unsigned char>& a, const std::vector<unsigned char>& b) {
+  int worst = 0;
+  for (size_t i = 0; i < a.size(); i++) worst = std::max(worst, std::abs(a[i] - b[i]));
+  return worst;
+}
+
+}  // namespace
+
+bool check_resample_against_reference(std::FILE* out) {
+  struct Case {
+    int src_w, src_h, dst_w, dst_h;
+  };
+  // Downscale, upscale, one axis each way, and odd sizes that leave SIMD remainders.
+  const Case cases[] = {
+      {640, 480, 129, 77}, {37, 23, 101, 67}, {300, 40, 61, 90}, {13, 29, 131, 7}, {1, 1, 9, 5}, {257, 255, 256, 257},
+  };
+  std::mt19937 rng(kSeed);
+  bool ok = true;
+  for (const Case& c : cases) {
+    const std::vector<unsigned char> src = random_rgba(&rng, c.src_w, c.src_h);
+    for (ScaleMode mode : {ScaleMode::Fit, ScaleMode::Fill, ScaleMode::Stretch}) {
+      std::vector<unsigned char> fast(static_cast<size_t>(c.dst_w) * c.dst_h * 4);
+      std::vector<unsigned char> ref(fast.size());
+      resample_rgba(src.data(), c.src_w, c.src_h, fast.data(), c.dst_w, c.dst_h, mode);
+      resample_rgba_reference(src.data(), c.src_w, c.src_h, ref.data(), c.dst_w, c.dst_h, mode);
+      const int diff = max_difference(fast, ref);
+      const bool pass = diff <= kResampleReferenceTolerance;
+      std::fprintf(out, "%s resample %dx%d -> %dx%d %s: max difference %d (tolerance %d)\n", pass ? "ok  " : "FAIL",
+                   c.src_w, c.src_h, c.dst_w, c.dst_h, mode_name(mode), diff, kResampleReferenceTolerance);
+      ok = ok && pass;
+    }
+  }
+  return ok;
+}
+
+bool check_composite_against_reference(std::FILE* out) {
+  // 8 pixels per AVX2 step, 4 per SSE2 step, then scalar: counts below, at and past each step.
+  const size_t counts[] = {1, 3, 4, 7, 8, 9, 12, 13, 17, 1921};
+  std::mt19937 rng(kSeed);
+  bool ok = true;
+  for (size_t n : counts) {
+    // Unconstrained bytes, so colour above alpha exercises the saturating add as well.
+    const std::vector<unsigned char> top = random_rgba(&rng, static_cast<int>(n), 1);
+    const std::vector<unsigned char> bottom = random_rgba(&rng, static_cast<int>(n), 1);
+    std::vector<unsigned char> fast = top, ref = top;
+    premultiply_rgba(fast.data(), n);
+    premultiply_rgba_reference(ref.data(), n);
+    const int premultiply_diff = max_difference(fast, ref);
+    blend_over(top.data(), bottom.data(), fast.data(), n);
+    blend_over_reference(top.data(), bottom.data(), ref.data(), n);
+    const int blend_diff = max_difference(fast, ref);
+    const bool pass = premultiply_diff == 0 && blend_diff == 0;
+    std::fprintf(out, "%s composite %zu pixels: premultiply difference %d, blend difference %d (must be 0)\n",
+                 pass ? "ok  " : "FAIL", n, premultiply_diff, blend_diff);
+    ok = ok && pass;
+  }
+  return ok;
+}
+
+bool check_scaler_against_cpu(FrameScaler* scaler, std::FILE* out) {
+  if (!scaler) return false;
+  struct Size {
+    int w, h;
+  };
+  // Output frame (odd, so the letterbox offsets round), then the layers bottom to top.
+  const Size frame = {161, 91};
+  const Size layer_sizes[] = {{400, 300}, {57, 83}, {160, 90}};
+  std::mt19937 rng(kSeed);
+  std::vector<std::vector<unsigned char>> sources;
+  for (const Size& s : layer_sizes) sources.push_back(random_rgba(&rng, s.w, s.h));
+  const size_t frame_bytes = static_cast<size_t>(frame.w) * frame.h * 4;
+  bool ok = true;
+  for (ScaleMode mode : {ScaleMode::Fit, ScaleMode::Fill, ScaleMode::Stretch}) {
+    if (!scaler->begin(frame.w, frame.h, mode)) {
+      std::fprintf(out, "FAIL gpu %s: the scaler could not start\n", mode_name(mode));
+      return false;
+    }
+    for (int count = 1; count <= static_cast<int>(sources.size()); count += 2) {
+      // The scaler takes straight alpha; composite_layers premultiplies its own copies in place.
+      std::vector<std::vector<unsigned char>> copies(sources.begin(), sources.begin() + count);
+      std::vector<LayerImage> layers(count);
+      for (int i = 0; i < count; i++) layers[i] = LayerImage{copies[i].data(), layer_sizes[i].w, layer_sizes[i].h};
+      std::vector<unsigned char> gpu(frame_bytes);
+      const bool scaled = scaler->submit(layers.data(), count) && scaler->receive(gpu.data());
+      std::vector<unsigned char> cpu(frame_bytes);
+      std::vector<unsigned char> scratch;
+      composite_layers(layers.data(), count, cpu.data(), frame.w, frame.h, mode, &scratch);
+      const int diff = scaled ? max_difference(gpu, cpu) : 255;
+      const bool pass = scaled && diff <= kFrameScalerTolerance;
+      std::fprintf(out, "%s gpu %d layer(s) -> %dx%d %s: max difference %d (tolerance %d)\n", pass ? "ok  " : "FAIL",
+                   count, frame.w, frame.h, mode_name(mode), diff, kFrameScalerTolerance);
+      ok = ok && pass;
+    }
+    scaler->end();
+  }
+  return ok;
+}
@@ -0,0 +1,18 @@
+#pragma once
+#include <cstdio>
+
+class FrameScaler;
+
+// Consistency checks of the optimized image paths against their references, run by `chya --self-check`.
+// Inputs are generated from a fixed seed. Each check prints one line per case to out and returns false if
+// any case is outside its stated tolerance.
+
+// resample_rgba against resample_rgba_reference for every ScaleMode: shrinking, growing and mixed axes,
+// including widths that are not a multiple of the SIMD step.
+bool check_resample_against_reference(std::FILE* out);
+// premultiply_rgba and blend_over against their scalar references, exactly, at pixel counts that run the
+// AVX2 and SSE2 kernels and each remainder path.
+bool check_composite_against_reference(std::FILE* out);
+// Frames from scaler against composite_layers, one and several overlapping layers with partial alpha, in
+// every ScaleMode; tolerance kFrameScalerTolerance. False also when scaler cannot begin.
+bool check_scaler_against_cpu(FrameScaler* scaler, std::FILE* out);
@@ -0,0 +1,11 @@
+#pragma once
+#include <memory>
+#include "stb_image.h"
+
+// Owning pointer for pixel buffers returned by stbi_load.
+struct StbiImageDeleter {
+  void operator()(unsigned char* p) const {
+    if (p) stbi_image_free(p);
+  }
+};
+using StbiImage = std::unique_ptr<unsigned char, StbiImageDeleter>;
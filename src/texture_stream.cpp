@@ -0,0 +1,68 @@
+#include "texture_stream.h"
+
+bool TextureStream::init(int width, int height, int buffer_count) {
+  destroy();
+  gl_ = gl_extra();
+  if (!gl_ || width <= 0 || height <= 0 || buffer_count <= 0) return false;
+  width_ = width;
+  height_ = height;
+  bytes_ = static_cast<GLsizeiptr>(width) * height * 4;
+  glGenTextures(2, textures_);
+  for (GLuint tex : textures_) {
+    glBindTexture(GL_TEXTURE_2D, tex);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+  }
+  glBindTexture(GL_TEXTURE_2D, 0);
+  pbos_.assign(buffer_count, 0);
+  mapped_.assign(buffer_count, nullptr);
+  glGenBuffers(buffer_count, pbos_.data());
+  for (int i = 0; i < buffer_count; i++) {
+    if (!map(i)) {
+      destroy();
+      return false;
+    }
+  }
+  return true;
+}
+
+void TextureStream::destroy() {
+  for (size_t i = 0; i < pbos_.size(); i++) {
+    if (mapped_[i]) {
+      glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pbos_[i]);
+      gl_->UnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+    }
+  }
+  glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+  if (!pbos_.empty())
+    glDeleteBuffers(static_cast<GLsizei>(pbos_.size()), pbos_.data());
+  pbos_.clear();
+  mapped_.clear();
+  if (textures_[0] != 0)
+    glDeleteTextures(2, textures_);
+  textures_[0] = textures_[1] = 0;
+  front_ = 0;
+  width_ = height_ = 0;
+}
+
+unsigned char* TextureStream::map(int i) {
+  glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pbos_[i]);
+  // Fresh storage each time: the driver keeps the old block alive until pending copies from it finish.
+  glBufferData(GL_PIXEL_UNPACK_BUFFER, bytes_, nullptr, GL_STREAM_DRAW);
+  mapped_[i] = static_cast<unsigned char*>(gl_->MapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, bytes_, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT));
+  glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+  return mapped_[i];
+}
+
+void TextureStream::upload(int i) {
+  glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pbos_[i]);
+  gl_->UnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+  mapped_[i] = nullptr;
+  glBindTexture(GL_TEXTURE_2D, textures_[front_ ^ 1]);
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+  gl_->TexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width_, height_, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+  glBindTexture(GL_TEXTURE_2D, 0);
+  glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+  map(i);
+}
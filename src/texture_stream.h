@@ -0,0 +1,40 @@
+#pragma once
+#include <vector>
+#include "gl_util.h"
+
+// Streams fixed-size RGBA frames into textures through a ring of pixel buffer objects. Buffers stay mapped
+// between uploads, so any thread can write a frame into one; upload() unmaps it and starts an asynchronous
+// glTexSubImage2D into the back of two preallocated textures, then maps the buffer again (orphaning the
+// storage the copy still reads from) so it can be refilled at once. All methods need the GL context current.
+class TextureStream {
+ public:
+  TextureStream() = default;
+  TextureStream(const TextureStream&) = delete;
+  TextureStream& operator=(const TextureStream&) = delete;
+  ~TextureStream() { destroy(); }
+
+  bool init(int width, int height, int buffer_count);
+  void destroy();
+
+  int width() const { return width_; }
+  int height() const { return height_; }
+  // Mapped memory of buffer i (width * height * 4 bytes); changes after upload(i).
+  unsigned char* buffer(int i) const { return mapped_[i]; }
+  // Copies buffer i into the back texture and re-maps it.
+  void upload(int i);
+  // Makes the last uploaded texture the front one.
+  void swap() { front_ ^= 1; }
+  GLuint front_texture() const { return textures_[front_]; }
+
+ private:
+  unsigned char* map(int i);
+
+  const GlExtra* gl_ = nullptr;
+  int width_ = 0;
+  int height_ = 0;
+  GLsizeiptr bytes_ = 0;
+  GLuint textures_[2] = {0, 0};
+  int front_ = 0;
+  std::vector<GLuint> pbos_;
+  std::vector<unsigned char*> mapped_;
+};
@@ -0,0 +1,352 @@
+#include "thumbnails.h"
+#include "imgui_impl_opengl3_loader.h"
+#include "bounded_queue.h"
+#include "resample.h"
+#include "stbi_image_ptr.h"
+#include "stb_image_write.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <filesystem>
+#include <list>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#ifndef GL_LINEAR_MIPMAP_LINEAR
+#define GL_LINEAR_MIPMAP_LINEAR 0x2703
+#endif
+#ifndef GL_TEXTURE_MAX_LEVEL
+#define GL_TEXTURE_MAX_LEVEL 0x813D
+#endif
+
+namespace fs = std::filesystem;
+
+namespace {
+
+// Requests are cheap, so the queue is deep enough for a large library; decoded images are bounded so
+// workers block once a few are waiting for upload.
+constexpr size_t kRequestQueueCapacity = 4096;
+constexpr size_t kResultQueueCapacity = 16;
+// Per-frame upload budget. At least one image is uploaded each frame even if it alone exceeds the budget.
+constexpr double kUploadBudgetSec = 0.004;
+constexpr size_t kUploadBudgetBytes = size_t(32) << 20;
+constexpr size_t kDefaultCacheBudgetBytes = size_t(256) << 20;
+
+// Media id in the high half, longest edge the texture was scaled to in the low half.
+using ThumbKey = uint64_t;
+
+ThumbKey thumb_key(int media_id, int max_edge) {
+  return static_cast<uint64_t>(static_cast<uint32_t>(media_id)) << 32 | static_cast<uint32_t>(max_edge);
+}
+
+int thumb_key_media(ThumbKey key) {
+  return static_cast<int>(static_cast<uint32_t>(key >> 32));
+}
+
+int thumb_key_edge(ThumbKey key) {
+  return static_cast<int>(static_cast<uint32_t>(key));
+}
+
+struct MipLevel {
+  int w = 0;
+  int h = 0;
+  std::vector<unsigned char> pixels;
+};
+
+struct ThumbRequest {
+  uint64_t generation = 0;
+  ThumbKey key;
+  std::string project_root;
+  std::string rel_path;
+};
+
+struct ThumbResult {
+  uint64_t generation = 0;
+  ThumbKey key;
+  std::vector<MipLevel> levels;  // empty if the image could not be decoded
+};
+
+enum class ThumbState { Queued, Ready, Failed };
+struct ThumbEntry {
+  ThumbState state = ThumbState::Queued;
+  GLuint tex = 0;
+  int w = 0;
+  int h = 0;
+  size_t bytes = 0;
+  uint64_t last_used_frame = 0;
+  std::list<ThumbKey>::iterator lru;  // valid while Ready
+};
+
+std::unordered_map<ThumbKey, ThumbEntry> g_thumb_cache;
+std::list<ThumbKey> g_thumb_lru;  // Ready entries, most recently used first
+size_t g_thumb_budget_bytes = kDefaultCacheBudgetBytes;
+uint64_t g_thumb_frame = 0;
+ThumbnailStats g_thumb_stats;
+// Bumped by clear_thumbnail_cache so workers skip, and the UI drops, requests made before the clear.
+std::atomic<uint64_t> g_thumb_generation{1};
+BoundedQueue<ThumbRequest> g_thumb_requests(kRequestQueueCapacity);
+BoundedQueue<ThumbResult> g_thumb_results(kResultQueueCapacity);
+std::vector<std::thread> g_thumb_workers;
+bool g_thumb_shutdown = false;
+
+uint64_t fnv1a(uint64_t h, const void* data, size_t size) {
+  const unsigned char* p = static_cast<const unsigned char*>(data);
+  for (size_t i = 0; i < size; i++) {
+    h ^= p[i];
+    h *= 1099511628211ull;
+  }
+  return h;
+}
+
+// <project>/.chya/thumbs/<hash>.jpg|png, the hash covering the media path, its size and mtime and the
+// thumbnail size, so an edited or replaced file gets a new entry. Returns false if the file is unreadable.
+bool disk_cache_path(const std::string& project_root, const std::string& rel_path, int max_edge, std::string* out) {
+  std::error_code ec;
+  const fs::path media = fs::path(project_root) / rel_path;
+  const uint64_t size = fs::file_size(media, ec);
+  if (ec) return false;
+  const int64_t mtime = fs::last_write_time(media, ec).time_since_epoch().count();
+  if (ec) return false;
+  const int version = 1;
+  uint64_t h = 14695981039346656037ull;
+  h = fnv1a(h, rel_path.data(), rel_path.size());
+  h = fnv1a(h, &size, sizeof(size));
+  h = fnv1a(h, &mtime, sizeof(mtime));
+  h = fnv1a(h, &max_edge, sizeof(max_edge));
+  h = fnv1a(h, &version, sizeof(version));
+  char name[32];
+  snprintf(name, sizeof(name), "%016llx", static_cast<unsigned long long>(h));
+  *out = (fs::path(project_root) / ".chya" / "thumbs" / name).string();
+  return true;
+}
+
+// Loads a thumbnail written by store_cached_thumbnail (either extension).
+bool load_cached_thumbnail(const std::string& cache_path, int max_edge, MipLevel* out) {
+  for (const char* ext : {".jpg", ".png"}) {
+    int w = 0, h = 0, comp = 0;
+    StbiImage img(stbi_load((cache_path + ext).c_str(), &w, &h, &comp, 4));
+    if (!img) continue;
+    if (w <= 0 || h <= 0 || std::max(w, h) > max_edge) return false;
+    out->w = w;
+    out->h = h;
+    out->pixels.assign(img.get(), img.get() + static_cast<size_t>(w) * h * 4);
+    return true;
+  }
+  return false;
+}
+
+// Opaque images are stored as JPEG, images with alpha as PNG. Written under a temporary name and renamed so
+// a concurrent reader never sees a partial file. Failures only cost a re-decode next time.
+void store_cached_thumbnail(const std::string& cache_path, const MipLevel& base, bool has_alpha) {
+  std::error_code ec;
+  fs::create_directories(fs::path(cache_path).parent_path(), ec);
+  const std::string final_path = cache_path + (has_alpha ? ".png" : ".jpg");
+  const std::string tmp_path = final_path + ".tmp";
+  const int ok = has_alpha ? stbi_write_png(tmp_path.c_str(), base.w, base.h, 4, base.pixels.data(), base.w * 4)
+                           : stbi_write_jpg(tmp_path.c_str(), base.w, base.h, 4, base.pixels.data(), 90);
+  if (ok)
+    fs::rename(tmp_path, final_path, ec);
+  if (!ok || ec)
+    fs::remove(tmp_path, ec);
+}
+
+// Decodes an image and scales it to fit max_edge (never up). has_alpha is set if the file has an alpha channel.
+bool decode_scaled(const std::string& path, int max_edge, MipLevel* out, bool* has_alpha) {
+  int w = 0, h = 0, comp = 0;
+  StbiImage img(stbi_load(path.c_str(), &w, &h, &comp, 4));
+  if (!img || w <= 0 || h <= 0) return false;
+  *has_alpha = comp == 2 || comp == 4;
+  const double scale = std::min(1., static_cast<double>(max_edge) / std::max(w, h));
+  out->w = std::max(1, static_cast<int>(std::lround(w * scale)));
+  out->h = std::max(1, static_cast<int>(std::lround(h * scale)));
+  if (out->w == w && out->h == h) {
+    out->pixels.assign(img.get(), img.get() + static_cast<size_t>(w) * h * 4);
+  } else {
+    out->pixels.resize(static_cast<size_t>(out->w) * out->h * 4);
+    resample_rgba(img.get(), w, h, out->pixels.data(), out->w, out->h, ScaleMode::Stretch);
+  }
+  return true;
+}
+
+// Produces the scaled image for a request, from the project's disk cache when possible, and builds its mip
+// chain down to 1x1.
+std::vector<MipLevel> decode_mip_chain(const ThumbRequest& req) {
+  std::vector<MipLevel> levels;
+  const int max_edge = thumb_key_edge(req.key);
+  MipLevel base;
+  std::string cache_path;
+  const bool cached = disk_cache_path(req.project_root, req.rel_path, max_edge, &cache_path);
+  if (!cached || !load_cached_thumbnail(cache_path, max_edge, &base)) {
+    bool has_alpha = false;
+    if (!decode_scaled((fs::path(req.project_root) / req.rel_path).string(), max_edge, &base, &has_alpha)) return levels;
+    if (cached)
+      store_cached_thumbnail(cache_path, base, has_alpha);
+  }
+  levels.push_back(std::move(base));
+  while (levels.back().w > 1 || levels.back().h > 1) {
+    const MipLevel& prev = levels.back();
+    MipLevel next;
+    next.w = std::max(1, prev.w / 2);
+    next.h = std::max(1, prev.h / 2);
+    next.pixels.resize(static_cast<size_t>(next.w) * next.h * 4);
+    resample_rgba(prev.pixels.data(), prev.w, prev.h, next.pixels.data(), next.w, next.h, ScaleMode::Stretch);
+    levels.push_back(std::move(next));
+  }
+  return levels;
+}
+
+void decode_worker() {
+  ThumbRequest req;
+  while (g_thumb_requests.pop(req)) {
+    if (req.generation != g_thumb_generation.load()) continue;
+    ThumbResult res;
+    res.generation = req.generation;
+    res.levels = decode_mip_chain(req);
+    res.key = req.key;
+    if (!g_thumb_results.push(std::move(res))) break;
+  }
+}
+
+void start_workers() {
+  if (!g_thumb_workers.empty() || g_thumb_shutdown) return;
+  // Leave a core for the UI thread; decoding is bounded by disk as much as CPU past a few threads.
+  unsigned n = std::thread::hardware_concurrency();
+  int count = std::clamp(static_cast<int>(n) - 1, 1, 4);
+  for (int i = 0; i < count; i++)
+    g_thumb_workers.emplace_back(decode_worker);
+}
+
+// Drops an entry and its texture. Returns the iterator following it.
+std::unordered_map<ThumbKey, ThumbEntry>::iterator erase_entry(std::unordered_map<ThumbKey, ThumbEntry>::iterator it) {
+  ThumbEntry& e = it->second;
+  if (e.state == ThumbState::Ready) {
+    glDeleteTextures(1, &e.tex);
+    g_thumb_lru.erase(e.lru);
+    g_thumb_stats.resident_bytes -= e.bytes;
+    g_thumb_stats.resident_count--;
+  } else if (e.state == ThumbState::Queued) {
+    g_thumb_stats.pending_count--;
+  }
+  return g_thumb_cache.erase(it);
+}
+
+GLuint upload_mip_chain(const std::vector<MipLevel>& levels) {
+  GLuint tex = 0;
+  glGenTextures(1, &tex);
+  glBindTexture(GL_TEXTURE_2D, tex);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, static_cast<GLint>(levels.size()) - 1);
+  for (size_t i = 0; i < levels.size(); i++)
+    glTexImage2D(GL_TEXTURE_2D, static_cast<GLint>(i), GL_RGBA, levels[i].w, levels[i].h, 0, GL_RGBA, GL_UNSIGNED_BYTE, levels[i].pixels.data());
+  glBindTexture(GL_TEXTURE_2D, 0);
+  return tex;
+}
+
+void evict_over_budget() {
+  while (g_thumb_stats.resident_bytes > g_thumb_budget_bytes && !g_thumb_lru.empty()) {
+    auto it = g_thumb_cache.find(g_thumb_lru.back());
+    if (it->second.last_used_frame >= g_thumb_frame) break;  // everything left was drawn last frame
+    erase_entry(it);
+    g_thumb_stats.evictions++;
+  }
+}
+
+ImTextureID lookup_texture(const std::string& project_root, const MediaRow& media, int max_edge, int* out_w, int* out_h) {
+  const ThumbKey key = thumb_key(media.id, max_edge);
+  auto it = g_thumb_cache.find(key);
+  if (it != g_thumb_cache.end()) {
+    ThumbEntry& e = it->second;
+    if (e.state != ThumbState::Ready) return nullptr;
+    g_thumb_stats.hits++;
+    e.last_used_frame = g_thumb_frame;
+    g_thumb_lru.splice(g_thumb_lru.begin(), g_thumb_lru, e.lru);
+    if (out_w) *out_w = e.w;
+    if (out_h) *out_h = e.h;
+    return (ImTextureID)(intptr_t)e.tex;
+  }
+  start_workers();
+  // If the queue is full the entry is not recorded, so the request is retried on a later frame.
+  ThumbRequest req{g_thumb_generation.load(), key, project_root, media.path};
+  if (g_thumb_requests.try_push(std::move(req))) {
+    g_thumb_cache.emplace(key, ThumbEntry{});
+    g_thumb_stats.misses++;
+    g_thumb_stats.pending_count++;
+  }
+  return nullptr;
+}
+
+}  // namespace
+
+ImTextureID get_thumbnail_texture(const std::string& project_root, const MediaRow& media, int* out_w, int* out_h) {
+  return lookup_texture(project_root, media, kThumbnailMaxEdge, out_w, out_h);
+}
+
+void upload_pending_thumbnails() {
+  const auto start = std::chrono::steady_clock::now();
+  size_t bytes = 0;
+  ThumbResult res;
+  while (g_thumb_results.try_pop(res)) {
+    auto it = g_thumb_cache.find(res.key);
+    if (res.generation != g_thumb_generation.load() || it == g_thumb_cache.end() || it->second.state != ThumbState::Queued)
+      continue;
+    ThumbEntry& e = it->second;
+    g_thumb_stats.pending_count--;
+    if (res.levels.empty()) {
+      e.state = ThumbState::Failed;
+      continue;
+    }
+    e.state = ThumbState::Ready;
+    e.tex = upload_mip_chain(res.levels);
+    e.w = res.levels[0].w;
+    e.h = res.levels[0].h;
+    e.bytes = 0;
+    for (const MipLevel& level : res.levels)
+      e.bytes += level.pixels.size();
+    e.last_used_frame = g_thumb_frame;
+    e.lru = g_thumb_lru.insert(g_thumb_lru.begin(), it->first);
+    g_thumb_stats.resident_bytes += e.bytes;
+    g_thumb_stats.resident_count++;
+    res.levels.clear();
+    bytes += e.bytes;
+    std::chrono::duration<double> spent = std::chrono::steady_clock::now() - start;
+    if (bytes >= kUploadBudgetBytes || spent.count() >= kUploadBudgetSec) break;
+  }
+  evict_over_budget();
+  g_thumb_frame++;
+}
+
+void forget_thumbnail(int media_id) {
+  for (auto it = g_thumb_cache.begin(); it != g_thumb_cache.end();)
+    it = thumb_key_media(it->first) == media_id ? erase_entry(it) : std::next(it);
+}
+
+void clear_thumbnail_cache() {
+  g_thumb_generation++;
+  for (auto it = g_thumb_cache.begin(); it != g_thumb_cache.end();)
+    it = erase_entry(it);
+}
+
+void shutdown_thumbnail_loader() {
+  g_thumb_shutdown = true;
+  g_thumb_requests.close();
+  g_thumb_results.close();
+  for (std::thread& t : g_thumb_workers)
+    t.join();
+  g_thumb_workers.clear();
+  clear_thumbnail_cache();
+}
+
+void set_thumbnail_cache_budget(size_t bytes) {
+  g_thumb_budget_bytes = bytes;
+}
+
+ThumbnailStats get_thumbnail_stats() {
+  ThumbnailStats s = g_thumb_stats;
+  s.budget_bytes = g_thumb_budget_bytes;
+  return s;
+}
@@ -0,0 +1,43 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include "imgui.h"
+#include "project_db.h"
+
+// Media thumbnails for the editor UI. Images are decoded and downscaled on background workers; everything
+// else must be called from the UI thread with the main GL context current.
+
+// Longest edge of the thumbnails used by the media panel and timeline.
+constexpr int kThumbnailMaxEdge = 256;
+
+// Returns the texture for a media file scaled to fit kThumbnailMaxEdge, or nullptr while it is still loading
+// (or failed to load). The first call queues the decode. out_w/out_h receive the texture size. Textures are
+// cached by media id, so a lookup allocates nothing; the cache holds one project at a time.
+// Scaled thumbnails are also saved under <project_root>/.chya/thumbs, so reopening a project skips decoding
+// the original files; entries are keyed by path, size and mtime and are never reused for a changed file.
+ImTextureID get_thumbnail_texture(const std::string& project_root, const MediaRow& media, int* out_w = nullptr, int* out_h = nullptr);
+// Uploads decoded thumbnails to GL textures until this frame's time/byte budget is spent, then evicts least
+// recently used textures above the cache budget. Call once per frame.
+void upload_pending_thumbnails();
+// Drops every cached size of one image (after it is removed from the project).
+void forget_thumbnail(int media_id);
+// Drops all thumbnails; decodes still in flight are discarded when they finish.
+void clear_thumbnail_cache();
+// Stops the decode workers and frees all textures. Call before the GL context is destroyed.
+void shutdown_thumbnail_loader();
+
+// Texture memory the cache may hold, mip chains included. Textures drawn in the current frame are never
+// evicted, so the cache can briefly exceed a budget smaller than one screenful.
+void set_thumbnail_cache_budget(size_t bytes);
+
+struct ThumbnailStats {
+  uint64_t hits = 0;        // lookups answered by a resident texture
+  uint64_t misses = 0;      // lookups that queued a decode
+  uint64_t evictions = 0;
+  size_t resident_bytes = 0;
+  size_t budget_bytes = 0;
+  int resident_count = 0;
+  int pending_count = 0;    // queued or decoding
+};
+ThumbnailStats get_thumbnail_stats();